@@ -1,7 +1,6 @@
 #ifndef FAULT_INJECT_ARM64_REGISTER_HPP
 #define FAULT_INJECT_ARM64_REGISTER_HPP
 
-#include <algorithm>
 #include <array>
 #include <elf.h>
 #include <sys/uio.h>
@@ -48,17 +47,10 @@ enum class reg {
     cpsr
 };
 
-static constexpr std::size_t n_registers = 35;
-
-struct reg_descriptor {
-    reg r;
-    int dwarf_r;
-    std::string name;
-};
-
+static constexpr std::size_t n_registers = 34;
 
 // have a look in /usr/include/sys/user.h for how to lay this out
-static const std::array<reg_descriptor, n_registers> g_register_descriptors{{
+static constexpr std::array<reg_descriptor, n_registers> g_register_descriptors{{
     {reg::x0, 0, "x0"},
     {reg::x1, 1, "x1"},
     {reg::x2, 2, "x2"},
@@ -95,58 +87,22 @@ static const std::array<reg_descriptor, n_registers> g_register_descriptors{{
     {reg::cpsr, 33, "cpsr"},
 }};
 
-uint64_t get_register_value(pid_t pid, reg r)
+void read_registers(pid_t pid, user_regs_struct *regs)
 {
-    user_regs_struct regs;
     struct iovec iov;
-    iov.iov_base = &regs;
-    iov.iov_len = sizeof(regs);
+    iov.iov_base = regs;
+    iov.iov_len = sizeof(*regs);
     ptrace(PTRACE_GETREGSET, pid, NT_PRSTATUS, &iov);
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [r](auto &&rd) { return rd.r == r; });
-
-    return *(reinterpret_cast<uint64_t *>(&regs) + (it - begin(g_register_descriptors)));
 }
 
-void set_register_value(pid_t pid, reg r, uint64_t value)
+void write_registers(pid_t pid, const user_regs_struct *regs)
 {
-    user_regs_struct regs;
     struct iovec iov;
-    iov.iov_base = &regs;
-    iov.iov_len = sizeof(regs);
-    ptrace(PTRACE_GETREGSET, pid, NT_PRSTATUS, &iov);
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [r](auto &&rd) { return rd.r == r; });
-
-    *(reinterpret_cast<uint64_t *>(&regs) + (it - begin(g_register_descriptors))) = value;
+    iov.iov_base = const_cast<user_regs_struct *>(regs);
+    iov.iov_len = sizeof(*regs);
     ptrace(PTRACE_SETREGSET, pid, NT_PRSTATUS, &iov);
 }
 
-uint64_t get_register_value_from_dwarf_register(pid_t pid, unsigned regnum)
-{
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [regnum](auto &&rd) { return static_cast<unsigned int>(rd.dwarf_r) == regnum; });
-    if (it == end(g_register_descriptors)) {
-        throw std::out_of_range{"Unknown dwarf register"};
-    }
-
-    return get_register_value(pid, it->r);
-}
-
-std::string get_register_name(reg r)
-{
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [r](auto &&rd) { return rd.r == r; });
-    return it->name;
-}
-
-reg get_register_from_name(const std::string &name)
-{
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [name](auto &&rd) { return rd.name == name; });
-    return it->r;
-}
-
 int get_breakpoint_rollback()
 {
     return 0;
@@ -2,17 +2,35 @@
 #define FAULT_INJECT_BREAKPOINT_HPP
 
 #include <cstdint>
+#include <cstring>
+
+#include "memory.hpp"
 
 namespace minidbg
 {
+#if defined(__amd64__) || defined(__x86_64__)
+
+// int3
+constexpr uint8_t breakpoint_instruction[] = {0xcc};
+
+#elif defined(__aarch64__) || defined(__arm__)
+
+// brk #0，小端序
+constexpr uint8_t breakpoint_instruction[] = {0x00, 0x00, 0x20, 0xd4};
+
+#else
+#error "unsupport the arch"
+#endif
+
 class breakpoint
 {
   public:
     breakpoint() = default;
-    breakpoint(pid_t pid, std::intptr_t addr) : pid(pid), addr(addr)
+    // 通过 memory 读写指令，使其中缓存的页保持最新
+    breakpoint(process_memory *memory, std::intptr_t addr) : memory(memory), addr(addr)
     {
         this->enabled = false;
-        this->staging_data = 0;
+        memset(this->staging_data, 0, sizeof(this->staging_data));
         this->hit = 0;
     }
     /**
@@ -20,6 +38,13 @@ class breakpoint
      * 
      */
     inline void enable();
+    /**
+     * @brief 批量设置断点时使用：data 指向调用者读取的 addr 处原有的 instruction_size 字节，
+     * 保存后替换为断点指令，由调用者写回 addr
+     *
+     * @param data
+     */
+    inline void enable(uint8_t *data);
     /**
      * @brief 使该addr地址断点失效
      * 
@@ -33,48 +58,34 @@ class breakpoint
      */
     bool is_enabled() const { return enabled; }
     auto get_address() const -> std::intptr_t { return addr; }
+    // 断点指令的字节数，只保存和恢复这些字节，相邻的断点互不覆盖
+    static constexpr size_t instruction_size = sizeof(breakpoint_instruction);
     int hit;
   private:
-    pid_t pid;
+    process_memory *memory;
     std::intptr_t addr;
     bool enabled;
-    uint64_t staging_data;
-    inline uint64_t get_breakpoint_instrument();
+    uint8_t staging_data[instruction_size];
 };
 void breakpoint::enable()
 {
-    staging_data = ptrace(PTRACE_PEEKDATA, pid, addr, nullptr);
-
-    uint64_t replaced = get_breakpoint_instrument();
-    ptrace(PTRACE_POKEDATA, pid, addr, replaced);
+    memory->read(addr, staging_data, instruction_size);
+    memory->write(addr, breakpoint_instruction, instruction_size);
     enabled = true;
 }
 
-void breakpoint::disable()
+void breakpoint::enable(uint8_t *data)
 {
-    ptrace(PTRACE_POKEDATA, pid, addr, staging_data);
-    enabled = false;
-}
-#if defined(__amd64__) || defined(__x86_64__)
-
-uint64_t breakpoint::get_breakpoint_instrument()
-{
-    // addr 是将要执行的指令位置，默认是小端序，所以直接需要最低位就行
-    uint64_t interrupt_instruction = 0xcc; // int3
-    return ((staging_data & ~0xff) | interrupt_instruction);
+    memcpy(staging_data, data, instruction_size);
+    memcpy(data, breakpoint_instruction, instruction_size);
+    enabled = true;
 }
 
-#elif defined(__aarch64__) || defined(__arm__)
-
-uint64_t breakpoint::get_breakpoint_instrument()
+void breakpoint::disable()
 {
-    uint64_t interrupt_instruction = 0xd4200000; // brk
-    return ((staging_data & ~0xffffffff) | interrupt_instruction);
+    memory->write(addr, staging_data, instruction_size);
+    enabled = false;
 }
-
-#else
-#error "unsupport the arch"
-#endif
 } // namespace faultInject
 
 #endif
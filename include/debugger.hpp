@@ -7,6 +7,8 @@
 #include <unordered_map>
 
 #include "breakpoint.hpp"
+#include "memory.hpp"
+#include "register.hpp"
 #include "dwarf/dwarf.hpp"
 #include "elf/elf.hpp"
 
@@ -45,11 +47,12 @@ namespace minidbg {
     class debugger {
     public:
         debugger (std::string prog_name, pid_t pid)
-             : m_prog_name{std::move(prog_name)}, m_pid{pid} {
+             : m_prog_name{std::move(prog_name)}, m_pid{pid}, m_regs{pid}, m_memory{pid} {
             auto fd = open(m_prog_name.c_str(), O_RDONLY);
 
             m_elf = elf::elf{elf::create_mmap_loader(fd)};
             m_dwarf = dwarf::dwarf{dwarf::elf::create_loader(m_elf)};
+            initialise_index_cache();
         }
         /**
          * @brief 当该类创建后，调用该函数，开始进行debug
@@ -75,7 +78,28 @@ namespace minidbg {
          * @param line
          */
         void set_breakpoint_at_source_line(const std::string& file, unsigned line);
+        /**
+         * @brief 在限定名与正则表达式 regex 匹配的所有函数设置断点，如 "^net::"
+         *
+         * @param regex
+         */
+        void set_breakpoint_at_regex(const std::string& regex);
+        /**
+         * @brief 在 addrs 的所有地址设置断点，已有断点的地址被跳过。
+         * 同一页中的断点只读写一次内存
+         *
+         * @param addrs
+         * @return size_t 新设置的断点数量
+         */
+        size_t set_breakpoints_at_addresses(std::vector<std::intptr_t> addrs);
         void dump_registers();
+        /**
+         * @brief 以十六进制显示 [address, address + len) 的内存，一次读取
+         *
+         * @param address
+         * @param len
+         */
+        void dump_memory(uint64_t address, size_t len);
         void print_backtrace();
         void read_variables();
         void print_source(const std::string& file_name, unsigned line, unsigned n_lines_context=2);
@@ -101,10 +125,30 @@ namespace minidbg {
         void handle_sigtrap(siginfo_t info);
 
         void initialise_load_address();
+        /**
+         * @brief 将不可写的 PT_LOAD 段登记到 m_memory，读取这些段时直接使用映射的 ELF 文件。
+         * 必须在 initialise_load_address 之后调用
+         *
+         */
+        void initialise_memory_image();
+        /**
+         * @brief 设置了环境变量 MINIDBG_INDEX_CACHE 时，加载该目录中以构建ID命名的索引缓存。
+         * 缓存不存在或二进制文件被修改过时，构建索引并保存。失败时回到按需构建索引
+         *
+         */
+        void initialise_index_cache();
         uint64_t offset_load_address(uint64_t addr);
         uint64_t offset_dwarf_address(uint64_t addr);
 
         auto get_function_from_pc(uint64_t pc) -> dwarf::die;
+        /**
+         * @brief 使用符号表把 pc 转换为"符号+偏移量"，找不到时返回"??"
+         *
+         * @param pc
+         * @param name 不为空时保存不带偏移量的符号名，找不到时为"??"
+         * @return std::string
+         */
+        std::string symbolize(uint64_t pc, std::string* name = nullptr);
         auto get_line_entry_from_pc(uint64_t pc) -> dwarf::line_table::iterator;
 
         auto read_memory(uint64_t address) -> uint64_t ;
@@ -112,6 +156,9 @@ namespace minidbg {
 
         std::string m_prog_name;
         pid_t m_pid;
+        // 被调试线程的寄存器，停止期间的读写都通过缓存，恢复执行前写回
+        register_cache m_regs;
+        process_memory m_memory;
         uint64_t m_load_address = 0;
         std::unordered_map<std::intptr_t,breakpoint> m_breakpoints;
         dwarf::dwarf m_dwarf;
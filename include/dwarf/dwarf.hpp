@@ -19,6 +19,8 @@ class loader;
 class compilation_unit;
 class type_unit;
 class die;
+class die_tree;
+class die_ref;
 class value;
 class expr;
 class expr_context;
@@ -26,13 +28,24 @@ class expr_result;
 class loclist;
 class rangelist;
 class line_table;
+class pc_index;
+class aranges;
+class line_index;
+class name_index;
+class type_index;
+class function_index;
 
 // 内部使用
 struct section;
 struct abbrev_entry;
+struct abbrev_table;
+struct range_table;
 struct cursor;
+struct index_cache;
+struct index_builder;
+struct die_access;
 
-// XXX Big missing support: .debug_aranges, .debug_frame, loclists,macros
+// XXX Big missing support: .debug_frame, loclists,macros
 
 /**
  * @brief 用于表示DWARF数据格式错误
@@ -84,6 +97,12 @@ std::string to_string(section_type v);
 /**
  * @brief 表示一个DWARF文件
  *
+ * 线程安全：同一个 dwarf 对象（以及从它得到的编译单元、类型单元、DIE、
+ * get_line_table() 返回的行号表和各个索引）可以同时在多个线程上查询。
+ * 惰性加载的节、类型单元、缩写表、根 DIE、行号表和索引都只初始化一次，
+ * 初始化完成后才对其他线程可见。load_index_cache 和 preload 会替换索引，
+ * 只能在对象被共享之前调用。迭代器和 die_str_map 等对象本身不能在线程间共享
+ *
  */
 class dwarf
 {
@@ -136,6 +155,7 @@ class dwarf
 
     /**
      * @brief 根据给定的类型签名返回对应的类型单元。
+     * 第一次调用时只读取 .debug_types 中各单元的头部建立签名索引，类型单元在第一次查找到时才创建。
      * 如果找不到对应的类型单元，则抛出out_of_range异常
      *
      * @param type_signature
@@ -151,7 +171,131 @@ class dwarf
      */
     std::shared_ptr<section> get_section(section_type type) const;
 
+    /**
+     * @brief 返回该文件的 PC 到函数 DIE 的地址索引。
+     * 索引在第一次调用时构建，之后的查询都是二分查找
+     *
+     * @return const pc_index&
+     */
+    const pc_index &get_pc_index() const;
+
+    /**
+     * @brief 返回该文件的地址到编译单元的查找表。
+     * 查找表在第一次调用时由 .debug_aranges 构建
+     *
+     * @return const aranges&
+     */
+    const aranges &get_aranges() const;
+
+    /**
+     * @brief 返回该文件的源代码行到地址的反向索引。
+     * 索引在第一次调用时解码所有编译单元的行号表构建
+     *
+     * @return const line_index&
+     */
+    const line_index &get_line_index() const;
+
+    /**
+     * @brief 返回该文件的全局名字索引。索引在第一次调用时构建
+     *
+     * @return const name_index&
+     */
+    const name_index &get_name_index() const;
+
+    /**
+     * @brief 返回该文件的全局类型名索引，包括所有编译单元和类型单元中的类型。
+     * 索引在第一次调用时构建
+     *
+     * @return const type_index&
+     */
+    const type_index &get_type_index() const;
+
+    /**
+     * @brief 返回该文件中有代码的函数的限定名索引。
+     * 索引在第一次调用时按编译单元在所有CPU上并行构建
+     *
+     * @return const function_index&
+     */
+    const function_index &get_function_index() const;
+
+    /**
+     * @brief 在 parallelism 个线程上预先解码所有单元的缩写表、根 DIE 和行号表，
+     * 并构建地址索引、名字索引、类型名索引、函数名索引和行号索引。各线程按单元收集结果，
+     * 空闲的线程从其他线程窃取编译单元，最后按编译单元的顺序合并，
+     * 结果与按需构建的索引相同。已经构建或从缓存加载的索引不会重新构建。
+     * 该函数返回前不能在其他线程上使用该对象
+     *
+     * @param parallelism 线程数，为0时使用硬件线程数
+     */
+    void preload(unsigned parallelism = 0) const;
+
+    /**
+     * @brief 从 path 映射之前保存的索引（地址索引、名字索引、行号索引、类型名索引和函数名索引），
+     * 之后的查询不再遍历DWARF数据。文件中记录的 key 与 key 不同时不加载，
+     * 调用者应该在 key 中包含能够标识二进制文件内容的信息（如构建ID和修改时间）。
+     * 该函数返回前不能在其他线程上使用该对象
+     *
+     * @param path
+     * @param key
+     * @return true 加载成功
+     */
+    bool load_index_cache(const std::string &path, const std::string &key) const;
+
+    /**
+     * @brief 构建所有索引并保存到 path，之后可以用 load_index_cache 加载
+     *
+     * @param path
+     * @param key
+     * @return true 保存成功
+     */
+    bool save_index_cache(const std::string &path, const std::string &key) const;
+
   private:
+    friend class unit;
+    friend class value;
+    friend class type_index;
+    friend struct index_builder;
+    friend std::shared_ptr<const range_table> die_range_table(const die &d);
+
+    /**
+     * @brief 返回 .debug_abbrev 中从 offset 开始的缩写表，每个不同的表只解析一次
+     *
+     * @param offset
+     * @param unit_data 使用该表的单元的数据，提供地址大小和格式
+     */
+    std::shared_ptr<const abbrev_table> get_abbrev_table(section_offset offset,
+                                                         const section &unit_data) const;
+
+    /**
+     * @brief 返回 .debug_ranges 中 offset 处的范围列表解码并排序后的结果，每个列表只解码一次
+     *
+     * @param offset
+     * @param addr_size 关联编译单元的地址大小
+     * @param base_addr 范围列表的基地址
+     */
+    std::shared_ptr<const range_table> get_range_table(section_offset offset, unsigned addr_size,
+                                                       taddr base_addr) const;
+
+    /**
+     * @brief 返回 .debug_info 中 offset 处的DIE，用于解析 DW_FORM::ref_addr。
+     * 用二分查找确定所在的编译单元，解析结果缓存在 dwarf 中
+     *
+     * @param offset 相对于 .debug_info 起始位置的偏移量
+     */
+    die resolve_ref_addr(section_offset offset) const;
+
+    /**
+     * @brief 返回类型单元的数量，没有 .debug_types 时返回0
+     *
+     */
+    size_t type_unit_count() const;
+
+    /**
+     * @brief 返回按签名排序的第 i 个类型单元
+     *
+     */
+    const type_unit &get_type_unit_at(size_t i) const;
+
     struct impl;
     // elf 的 loader
     std::shared_ptr<impl> m;
@@ -248,6 +392,14 @@ class unit
      */
     const abbrev_entry &get_abbrev(std::uint64_t acode) const;
 
+    /**
+     * @brief 返回该单元的扁平DIE树。第一次调用时一次解析整个单元，
+     * 之后遍历DIE树只需要在数组上线性扫描
+     *
+     * @return const die_tree&
+     */
+    const die_tree &get_die_tree() const;
+
   protected:
     friend struct ::std::hash<unit>;
     // impl结构是一个私有结构体，用于存储unit类的实现细节
@@ -281,11 +433,20 @@ class compilation_unit : public unit
 
     /**
      * @brief 返回该编译单元的行号表（line table）。
-     * 如果该编译单元没有行号表，则返回一个无效的行号表对象
+     * 如果该编译单元没有行号表，则返回一个无效的行号表对象。
+     * 第一次调用时只读取头部，迭代仍是惰性的
      *
      * @return const line_table&
      */
     const line_table &get_line_table() const;
+
+    /**
+     * @brief 返回该编译单元已经完全解码的行号表（见 line_table::materialize），
+     * 适合反复调用 find_address 的调用者。行号程序格式错误时抛出format_error异常
+     *
+     * @return const line_table&
+     */
+    const line_table &get_materialized_line_table() const;
 };
 
 /**
@@ -438,6 +599,7 @@ class die
     friend class unit;
     friend class type_unit;
     friend class value;
+    friend struct die_access;
     // XXX If we can get the CU, we don't need this
     friend struct ::std::hash<die>;
 
@@ -450,8 +612,11 @@ class die
     const abbrev_entry *abbrev;
     // 该DIE相对于编译单元的起始位置的偏移量
     section_offset offset;
+    // 第一个属性的偏移量，相对于编译单元的子节。
+    // 缩写中固定长度的属性的偏移量由缩写给出，不需要逐个记录
+    section_offset attr_start;
     /**
-     * @brief 属性的偏移量，相对于编译单元的子节。
+     * @brief 缩写中固定长度的前缀之后的属性的偏移量，相对于编译单元的子节。
      * 但大多数DIE往往具有六个或更少的属性，默认使用六个属性的空间
      *
      */
@@ -471,6 +636,14 @@ class die
      * @param off
      */
     void read(section_offset off);
+
+    /**
+     * @brief 返回缩写中第 i 个属性的偏移量，相对于编译单元的子节
+     *
+     * @param i
+     * @return section_offset
+     */
+    section_offset attr_offset(unsigned i) const;
 };
 
 /**
@@ -528,6 +701,214 @@ inline die::iterator die::end() const
     return iterator();
 }
 
+/**
+ * @brief 一个单元中所有DIE按先序排列的扁平数组，DIE的每个字段分别存放在一个连续的数组中
+ * （标签、缩写、偏移量、父节点、第一个子节点、下一个兄弟节点和深度）。
+ * 数组只解析一次单元，不保存属性，需要属性时用 die_ref::get 读取完整的 DIE。
+ * 由单元持有，通过 unit::get_die_tree 获取
+ *
+ */
+class die_tree
+{
+  public:
+    class iterator;
+
+    die_tree() = default;
+    die_tree(const die_tree &o) = default;
+    die_tree(die_tree &&o) = default;
+    die_tree &operator=(const die_tree &o) = default;
+    die_tree &operator=(die_tree &&o) = default;
+
+    /**
+     * @brief 解析单元 u 中的所有DIE
+     *
+     * @param u
+     */
+    explicit die_tree(const unit &u);
+
+    bool valid() const
+    {
+        return !!m;
+    }
+
+    /**
+     * @brief 返回DIE的数量（不包括兄弟列表的终止符）
+     *
+     * @return size_t
+     */
+    size_t size() const;
+
+    /**
+     * @brief 返回先序中的第 i 个DIE，第0个是单元的根DIE
+     *
+     * @param i
+     * @return die_ref
+     */
+    die_ref at(size_t i) const;
+
+    /**
+     * @brief 二分查找相对于单元的偏移量为 off 的DIE，找不到时返回无效的 die_ref
+     *
+     * @param off
+     * @return die_ref
+     */
+    die_ref find(section_offset off) const;
+
+    /**
+     * @brief 按先序遍历所有的DIE
+     *
+     */
+    iterator begin() const;
+    iterator end() const;
+
+  private:
+    friend class die_ref;
+
+    struct impl;
+    std::shared_ptr<impl> m;
+};
+
+/**
+ * @brief 指向 die_tree 中一个DIE的轻量句柄，复制时只复制一个指针和一个下标。
+ * 与 die 一样由单元保持有效。对无效的句柄调用 parent、first_child 和
+ * next_sibling 返回无效的句柄
+ *
+ */
+class die_ref
+{
+  public:
+    die_ref() : tree(nullptr), idx(0) {}
+
+    bool valid() const
+    {
+        return tree != nullptr;
+    }
+
+    /**
+     * @brief 返回该DIE在 die_tree 中的下标
+     *
+     * @return uint32_t
+     */
+    uint32_t index() const
+    {
+        return idx;
+    }
+
+    DW_TAG tag() const;
+
+    /**
+     * @brief 返回该DIE的深度，根DIE的深度为0
+     *
+     * @return unsigned
+     */
+    unsigned depth() const;
+
+    /**
+     * @brief 返回该DIE相对于其单元的偏移量
+     *
+     * @return section_offset
+     */
+    section_offset get_unit_offset() const;
+
+    /**
+     * @brief 如果该DIE的缩写中有属性 attr，则返回true。不读取属性的值
+     *
+     * @param attr
+     */
+    bool has(DW_AT attr) const;
+
+    /**
+     * @brief 返回父节点，根DIE返回无效的 die_ref
+     *
+     */
+    die_ref parent() const;
+
+    /**
+     * @brief 返回第一个子节点，没有子节点时返回无效的 die_ref
+     *
+     */
+    die_ref first_child() const;
+
+    /**
+     * @brief 返回下一个兄弟节点，没有时返回无效的 die_ref
+     *
+     */
+    die_ref next_sibling() const;
+
+    /**
+     * @brief 返回该DIE的子树之后第一个DIE的下标，
+     * [index(), subtree_end()) 是该DIE及其所有后代
+     *
+     * @return uint32_t
+     */
+    uint32_t subtree_end() const;
+
+    /**
+     * @brief 读取完整的DIE以访问其属性
+     *
+     * @return die
+     */
+    die get() const;
+
+    bool operator==(const die_ref &o) const
+    {
+        return tree == o.tree && idx == o.idx;
+    }
+
+    bool operator!=(const die_ref &o) const
+    {
+        return !(*this == o);
+    }
+
+  private:
+    friend class die_tree;
+    friend class die_tree::iterator;
+
+    die_ref(const die_tree::impl *tree, uint32_t idx)
+        : tree(tree), idx(idx) {}
+
+    const die_tree::impl *tree;
+    uint32_t idx;
+};
+
+/**
+ * @brief 按先序遍历 die_tree 的迭代器
+ *
+ */
+class die_tree::iterator
+{
+  public:
+    iterator() = default;
+
+    die_ref operator*() const
+    {
+        return ref;
+    }
+
+    const die_ref *operator->() const
+    {
+        return &ref;
+    }
+
+    iterator &operator++()
+    {
+        ref.idx++;
+        return *this;
+    }
+
+    bool operator!=(const iterator &o) const
+    {
+        return ref != o.ref;
+    }
+
+  private:
+    friend class die_tree;
+
+    explicit iterator(die_ref ref) : ref(ref) {}
+
+    die_ref ref;
+};
+
 /**
  * @brief 异常类，表示值的类型不匹配
  *
@@ -967,7 +1348,8 @@ class rangelist
               unsigned cu_addr_size, taddr cu_low_pc);
 
     /**
-     * @brief 根据一系列{低地址，高地址}对构造一个范围列表
+     * @brief 根据一系列{低地址，高地址}对构造一个范围列表。
+     * 只有一个范围时存储在对象内部，不分配内存
      *
      * @param ranges
      */
@@ -1006,8 +1388,10 @@ class rangelist
     bool contains(taddr addr) const;
 
   private:
-    std::vector<taddr> synthetic; // 用于存储合成的范围列表
+    small_vector<std::pair<taddr, taddr>, 1> synthetic; // 用于存储合成的范围列表
     std::shared_ptr<section> sec;
+    section_offset off;  // 范围列表在sec中的偏移量
+    unsigned addr_size;  // 关联编译单元的地址大小
     taddr base_addr; // 范围列表的基地址
 };
 
@@ -1040,15 +1424,26 @@ class rangelist::entry
 class rangelist::iterator
 {
   public:
-    iterator() : sec(nullptr), base_addr(0), pos(0) {}
+    iterator()
+        : sec(nullptr), synth(nullptr), synth_end(nullptr),
+          addr_size(0), base_addr(0), pos(0) {}
 
     /**
-     * @brief 根据给定的section对象和基地址构造一个迭代器
+     * @brief 根据给定的section对象和基地址构造一个迭代器。
+     * 迭代器只借用sec，不能比产生它的范围列表存活得更久
      *
      * @param sec
+     * @param off 范围列表在sec中的偏移量
+     * @param addr_size 地址大小
      * @param base_addr
      */
-    iterator(const std::shared_ptr<section> &sec, taddr base_addr);
+    iterator(const section *sec, section_offset off, unsigned addr_size, taddr base_addr);
+
+    /**
+     * @brief 构造一个遍历合成范围 [begin, end) 的迭代器
+     *
+     */
+    iterator(const std::pair<taddr, taddr> *begin, const std::pair<taddr, taddr> *end);
     iterator(const iterator &o) = default;
     iterator(iterator &&o) = default;
     iterator &operator=(const iterator &o) = default;
@@ -1072,7 +1467,7 @@ class rangelist::iterator
 
     bool operator==(const iterator &o) const
     {
-        return sec == o.sec && pos == o.pos;
+        return sec == o.sec && synth == o.synth && pos == o.pos;
     }
 
     bool operator!=(const iterator &o) const
@@ -1088,7 +1483,10 @@ class rangelist::iterator
     iterator &operator++();
 
   private:
-    std::shared_ptr<section> sec;
+    const section *sec;
+    // 合成的范围列表中下一个范围和末尾
+    const std::pair<taddr, taddr> *synth, *synth_end;
+    unsigned addr_size;
     taddr base_addr;
     section_offset pos;
     rangelist::entry entry;
@@ -1142,6 +1540,23 @@ class line_table
      */
     iterator find_address(taddr addr) const;
 
+    /**
+     * @brief 将整个行号程序解码一次，保存为按序列排序的列式数组。
+     * 之后 find_address 使用二分查找，迭代器递增直接读取解码后的行，
+     * 不再重新执行行号状态机。未调用此函数时迭代仍是惰性的。重复调用没有额外开销。
+     * 可以在多个线程上同时调用，也可以与其他线程上的惰性迭代同时进行
+     *
+     */
+    void materialize() const;
+
+    /**
+     * @brief 如果行号表已经通过 materialize 解码，则返回true
+     *
+     * @return true
+     * @return false
+     */
+    bool materialized() const;
+
     /**
      * @brief 返回行号表中第`index`个文件。这些索引通常用于声明和调用坐标。
      * 如果索引超出范围，将抛出`out_of_range`异常
@@ -1260,12 +1675,32 @@ class line_table::iterator
     }
 
   private:
+    friend class line_table;
+
+    /**
+     * @brief 返回指向解码后行号表第 row 行的迭代器
+     *
+     * @param table
+     * @param row
+     * @return iterator
+     */
+    static iterator at_row(const line_table *table, uint32_t row);
+
+    /**
+     * @brief 从解码后的行号表中读取第 row 行
+     *
+     * @param row
+     */
+    void load_row(uint32_t row);
+
     // 行号表对象
     const line_table *table;
     // 当前行号表条目和寄存器
     line_table::entry entry, regs;
     // 迭代器的偏移量
     section_offset pos;
+    // 当前条目在解码后的行号表中的行号，惰性迭代时为 ~0
+    uint32_t row;
     /**
      * @brief 处理下一个操作码
      *
@@ -1276,6 +1711,68 @@ class line_table::iterator
     bool step(cursor *cur);
 };
 
+/**
+ * @brief 源代码行到地址的反向索引。
+ * 收集所有编译单元行号表中 is_stmt 的行，包括通过 include_directories 和
+ * file_names 引入的头文件。文件路径被驻留为整数编号，(文件, 行) 通过哈希表查找。
+ * 同一行在同一个函数（或内联实例）中只保留最低的地址，
+ * 因此内联到多个位置或出现在多个编译单元中的行会得到多个地址
+ *
+ */
+class line_index
+{
+  public:
+    /**
+     * @brief 解码 dw 中所有编译单元的行号表构建索引
+     *
+     * @param dw
+     */
+    explicit line_index(const dwarf &dw);
+
+    line_index() = default;
+    line_index(const line_index &o) = default;
+    line_index(line_index &&o) = default;
+    line_index &operator=(const line_index &o) = default;
+    line_index &operator=(line_index &&o) = default;
+
+    bool valid() const
+    {
+        return !!m;
+    }
+
+    /**
+     * @brief 返回源文件 file 第 line 行对应的所有地址，按地址递增排列。
+     * file 可以是完整路径，也可以是路径末尾的若干个完整部分，如"hello.cpp"
+     * 或"test/hello.cpp"，此时匹配所有以其结尾的文件
+     *
+     * @param file
+     * @param line
+     * @return std::vector<taddr> 没有匹配的行时为空
+     */
+    std::vector<taddr> find(const std::string &file, unsigned line) const;
+
+    /**
+     * @brief 返回索引中不同文件路径的数量
+     *
+     * @return size_t
+     */
+    size_t files() const;
+
+    /**
+     * @brief 返回索引中地址的数量
+     *
+     * @return size_t
+     */
+    size_t size() const;
+
+  private:
+    friend struct index_cache;
+    friend struct index_builder;
+
+    struct impl;
+    std::shared_ptr<impl> m;
+};
+
 //////////////////////////////////////////////////////////////////
 // Type-safe attribute getters
 //
@@ -1356,6 +1853,15 @@ DW_VIS at_visibility(const die &d);
  */
 rangelist die_pc_range(const die &d);
 
+/**
+ * @brief 判断DIE的PC范围是否包含pc，等价于 die_pc_range(d).contains(pc)，但不分配内存。
+ * DW_AT::ranges 的范围列表在第一次查询时解码、排序并缓存在 dwarf 中，之后使用二分查找
+ *
+ * @param d
+ * @param pc
+ */
+bool die_pc_contains(const die &d, taddr pc);
+
 //////////////////////////// 工具类 //////////////////////////////
 
 /**
@@ -1406,6 +1912,316 @@ class die_str_map
     std::shared_ptr<impl> m;
 };
 
+/**
+ * @brief PC 到函数 DIE 的地址索引。
+ * 所有 DW_TAG::subprogram 和 DW_TAG::inlined_subroutine 的地址范围被展开成
+ * 一个按地址排序、互不重叠的区间数组，每个区间记录覆盖它的最内层函数，
+ * 查询只需一次二分查找。索引引用所属 dwarf 对象的编译单元，
+ * 因此不能比该 dwarf 对象存活得更久
+ *
+ */
+class pc_index
+{
+  public:
+    /**
+     * @brief 遍历 dw 中所有编译单元的 DIE 树构建索引
+     *
+     * @param dw
+     */
+    explicit pc_index(const dwarf &dw);
+
+    pc_index() = default;
+    pc_index(const pc_index &o) = default;
+    pc_index(pc_index &&o) = default;
+    pc_index &operator=(const pc_index &o) = default;
+    pc_index &operator=(pc_index &&o) = default;
+
+    bool valid() const
+    {
+        return !!m;
+    }
+
+    /**
+     * @brief 返回包含 pc 的最内层函数 DIE（可能是内联实例）。
+     * 如果没有函数包含 pc，则返回无效的 DIE
+     *
+     * @param pc
+     * @return die
+     */
+    die find(taddr pc) const;
+
+    /**
+     * @brief 返回包含 pc 的所有函数 DIE，最内层的在最前面，
+     * 之后依次是内联它的外层函数
+     *
+     * @param pc
+     * @return std::vector<die>
+     */
+    std::vector<die> find_stack(taddr pc) const;
+
+    /**
+     * @brief 与 find 相同，但只返回函数 DIE 在 .debug_info 中的偏移量，不读取 DIE
+     *
+     * @param pc
+     * @param out
+     * @return true 有函数包含 pc
+     */
+    bool find_offset(taddr pc, section_offset *out) const;
+
+    /**
+     * @brief 返回索引中函数 DIE 的数量
+     *
+     * @return size_t
+     */
+    size_t size() const;
+
+  private:
+    friend struct index_cache;
+    friend struct index_builder;
+
+    struct impl;
+    std::shared_ptr<impl> m;
+};
+
+/**
+ * @brief 地址到编译单元的查找表。
+ * 由 .debug_aranges 中的地址范围构建，展平成互不相交的范围后按地址排序，查询为二分查找。
+ * 不同编译单元的范围重叠时，重叠部分属于起始地址较大的范围。
+ * 如果文件没有 .debug_aranges 节，或者某些编译单元没有出现在其中（包括版本无法识别的组），
+ * 则使用这些编译单元根 DIE 的地址范围代替
+ *
+ */
+class aranges
+{
+  public:
+    /**
+     * @brief 读取 dw 的 .debug_aranges 节构建查找表
+     *
+     * @param dw
+     */
+    explicit aranges(const dwarf &dw);
+
+    aranges() = default;
+    aranges(const aranges &o) = default;
+    aranges(aranges &&o) = default;
+    aranges &operator=(const aranges &o) = default;
+    aranges &operator=(aranges &&o) = default;
+
+    bool valid() const
+    {
+        return !!m;
+    }
+
+    /**
+     * @brief 返回包含地址 pc 的编译单元。如果没有编译单元包含 pc，则返回nullptr
+     *
+     * @param pc
+     * @return const compilation_unit*
+     */
+    const compilation_unit *find(taddr pc) const;
+
+    /**
+     * @brief 返回合并后的地址范围数量
+     *
+     * @return size_t
+     */
+    size_t size() const;
+
+  private:
+    friend struct index_cache;
+
+    struct impl;
+    std::shared_ptr<impl> m;
+};
+
+/**
+ * @brief 全局名字到 DIE 的索引，包括函数、全局变量和类型。
+ * 编译单元出现在 .debug_pubnames 中时直接使用其中的名字（以及 .debug_pubtypes），
+ * pubnames 只包含外部名字，这些单元中没有 DW_AT_external 的 DIE 仍通过遍历 DIE 树加入；
+ * 其他单元遍历整个 DIE 树。对 DW_AT_name 和 DW_AT_linkage_name 建立索引。
+ * 定义通过 DW_AT_specification 引用声明时，使用声明的名字
+ *
+ */
+class name_index
+{
+  public:
+    /**
+     * @brief 读取 dw 的名字查找表或遍历 DIE 树构建索引
+     *
+     * @param dw
+     */
+    explicit name_index(const dwarf &dw);
+
+    name_index() = default;
+    name_index(const name_index &o) = default;
+    name_index(name_index &&o) = default;
+    name_index &operator=(const name_index &o) = default;
+    name_index &operator=(name_index &&o) = default;
+
+    bool valid() const
+    {
+        return !!m;
+    }
+
+    /**
+     * @brief 返回名字为 name 的所有 DIE，包括声明和定义
+     *
+     * @param name 名字或链接名
+     * @return std::vector<die>
+     */
+    std::vector<die> find(const std::string &name) const;
+
+    /**
+     * @brief 返回索引中不同名字的数量
+     *
+     * @return size_t
+     */
+    size_t size() const;
+
+  private:
+    friend struct index_cache;
+    friend struct index_builder;
+
+    struct impl;
+    std::shared_ptr<impl> m;
+};
+
+/**
+ * @brief 全局类型名到 DIE 的索引，覆盖所有编译单元和类型单元。
+ * 类型名是由外层命名空间和类组成的限定名，如 "ns::Outer::Inner"，
+ * 匿名命名空间记作 "(anonymous namespace)"。
+ * 同一个名字有定义时只保留定义，标签和大小相同的定义（ODR 相同的多份拷贝）只保留一个；
+ * 只有声明时保留一个声明
+ *
+ */
+class type_index
+{
+  public:
+    /**
+     * @brief 遍历 dw 所有单元的 DIE 树构建索引
+     *
+     * @param dw
+     */
+    explicit type_index(const dwarf &dw);
+
+    type_index() = default;
+    type_index(const type_index &o) = default;
+    type_index(type_index &&o) = default;
+    type_index &operator=(const type_index &o) = default;
+    type_index &operator=(type_index &&o) = default;
+
+    bool valid() const
+    {
+        return !!m;
+    }
+
+    /**
+     * @brief 返回限定名为 name 的类型，优先返回定义。查找不分配内存
+     *
+     * @param name 限定名
+     * @return die 没有这个类型时返回无效的 DIE
+     */
+    die find(const std::string &name) const;
+
+    /**
+     * @brief 返回限定名为 name 的所有不同的类型，定义在前
+     *
+     * @param name 限定名
+     * @return std::vector<die>
+     */
+    std::vector<die> find_all(const std::string &name) const;
+
+    /**
+     * @brief 返回索引中不同类型名的数量
+     *
+     * @return size_t
+     */
+    size_t size() const;
+
+  private:
+    friend struct index_cache;
+    friend struct index_builder;
+
+    struct impl;
+    std::shared_ptr<impl> m;
+};
+
+/**
+ * @brief 有代码的函数（带 DW_AT_low_pc 或 DW_AT_ranges 的 DW_TAG_subprogram）的限定名索引，
+ * 如 "ns::Foo::bar"。限定名由函数声明所在的命名空间和类组成，
+ * 定义通过 DW_AT_specification 或 DW_AT_abstract_origin 找到声明。
+ * 除了完整的限定名，还可以按以 "::" 分隔的后缀查找，"Foo::bar" 和 "bar" 都能找到 "ns::Foo::bar"
+ *
+ */
+class function_index
+{
+  public:
+    /**
+     * @brief 遍历 dw 所有编译单元的 DIE 树构建索引
+     *
+     * @param dw
+     */
+    explicit function_index(const dwarf &dw);
+
+    function_index() = default;
+    function_index(const function_index &o) = default;
+    function_index(function_index &&o) = default;
+    function_index &operator=(const function_index &o) = default;
+    function_index &operator=(function_index &&o) = default;
+
+    bool valid() const
+    {
+        return !!m;
+    }
+
+    /**
+     * @brief 返回限定名恰好为 name 的所有函数，包括所有重载
+     *
+     * @param name 限定名
+     * @return std::vector<die>
+     */
+    std::vector<die> find(const std::string &name) const;
+
+    /**
+     * @brief 返回限定名的后缀为 name 的所有函数，后缀从某一级作用域开始
+     *
+     * @param name 限定名或其后缀
+     * @return std::vector<die>
+     */
+    std::vector<die> find_suffix(const std::string &name) const;
+
+    /**
+     * @brief 返回索引中不同限定名的数量
+     *
+     * @return size_t
+     */
+    size_t size() const;
+
+    /**
+     * @brief 返回第 i 个限定名，限定名按字典序排列。
+     * 与 get_functions 一起用于遍历所有限定名，如按正则表达式匹配函数
+     *
+     * @param i 小于 size()
+     * @return const char*
+     */
+    const char *get_name(size_t i) const;
+
+    /**
+     * @brief 返回限定名为 get_name(i) 的所有函数
+     *
+     * @param i 小于 size()
+     * @return std::vector<die>
+     */
+    std::vector<die> get_functions(size_t i) const;
+
+  private:
+    friend struct index_cache;
+    friend struct index_builder;
+
+    struct impl;
+    std::shared_ptr<impl> m;
+};
+
 /**
  * @brief 声明或内联实例的声明或调用坐标。
  *
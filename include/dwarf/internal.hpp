@@ -4,6 +4,8 @@
 #include "../hex.hpp"
 #include "dwarf.hpp"
 
+#include <cstring>
+#include <functional>
 #include <stdexcept>
 #include <type_traits>
 #include <unordered_map>
@@ -102,19 +104,85 @@ struct section {
 };
 
 /**
- * @brief 表示一个指向DWARF节的游标。游标提供了反序列化操作和边界检查
+ * @brief 不拥有所有权的节视图，按值复制，不涉及引用计数。
+ * 节的数据由 dwarf 的 loader 持有，视图只在 dwarf 对象存活期间有效
+ *
+ */
+struct section_view {
+    section_type type;
+    const char *begin, *end;
+    format fmt;
+    byte_order ord;
+    unsigned addr_size;
+
+    section_view()
+        : type(section_type::info), begin(nullptr), end(nullptr),
+          fmt(format::unknown), ord(byte_order::lsb), addr_size(0) {}
+    section_view(const section &sec)
+        : type(sec.type), begin(sec.begin), end(sec.end),
+          fmt(sec.fmt), ord(sec.ord), addr_size(sec.addr_size) {}
+
+    /**
+     * @brief 与 section::slice 相同，但不分配内存
+     *
+     */
+    section_view slice(section_offset start, section_length len,
+                       format fmt = format::unknown,
+                       unsigned addr_size = 0) const
+    {
+        section_view sub(*this);
+        sub.begin = begin + start;
+        sub.end = sub.begin + std::min(len, (section_length)(end - sub.begin));
+        if (fmt != format::unknown)
+            sub.fmt = fmt;
+        if (addr_size != 0)
+            sub.addr_size = addr_size;
+        return sub;
+    }
+
+    size_t size() const
+    {
+        return end - begin;
+    }
+};
+
+/**
+ * @brief 一个范围列表解码后的结果：按起始地址排序并合并了重叠的范围，
+ * 用二分查找判断地址是否在列表中。构造后不再修改，由 dwarf 缓存
+ *
+ */
+struct range_table {
+    std::vector<std::pair<taddr, taddr>> ranges;
+
+    explicit range_table(const rangelist &rl);
+
+    bool contains(taddr addr) const;
+};
+
+/**
+ * @brief 返回 d 的 DW_AT::ranges 解码后的范围表，由 dwarf 按列表缓存。
+ * d 必须有 DW_AT::ranges 属性
+ *
+ */
+std::shared_ptr<const range_table> die_range_table(const die &d);
+
+/**
+ * @brief 表示一个指向DWARF节的游标。游标提供了反序列化操作和边界检查。
+ * 游标只借用节（见 section_view），创建和复制游标都不会修改引用计数
  * 
  */
 struct cursor {
-    // 指向section结构体的共享指针，表示游标所在的节
-    std::shared_ptr<section> sec;
+    // 游标所在的节
+    section_view sec;
     // 指向游标当前位置的指针
     const char *pos;
 
     cursor()
         : pos(nullptr) {}
-    cursor(const std::shared_ptr<section> sec, section_offset offset = 0)
-        : sec(sec), pos(sec->begin + offset) {}
+    cursor(const section_view &sec, section_offset offset = 0)
+        : sec(sec), pos(sec.begin + offset) {}
+    cursor(const std::shared_ptr<section> &sec, section_offset offset = 0)
+        : sec(*sec), pos(sec->begin + offset) {}
 
     /**
      * @brief 读取一个子节。游标必须位于一个初始长度处。
@@ -124,6 +192,12 @@ struct cursor {
      * @return std::shared_ptr<section> 
      */
     std::shared_ptr<section> subsection();
+    /**
+     * @brief 与 subsection 相同，但返回不分配内存的视图
+     *
+     * @return section_view
+     */
+    section_view subview();
     /**
      * @brief 读取一个有符号LEB128整数
      * 根据LEB128编码规则，从游标当前位置开始逐个字节读取，直到遇到最后一个字节。
@@ -163,7 +237,7 @@ struct cursor {
      */
     void ensure(section_offset bytes)
     {
-        if ((section_offset)(sec->end - pos) < bytes || pos >= sec->end)
+        if ((section_offset)(sec.end - pos) < bytes || pos >= sec.end)
             underflow();
     }
 
@@ -180,7 +254,7 @@ struct cursor {
         static_assert(sizeof(T) <= 8, "T too big");
         uint64_t val = 0;
         const unsigned char *p = (const unsigned char *)pos;
-        if (sec->ord == byte_order::lsb) {
+        if (sec.ord == byte_order::lsb) {
             for (unsigned i = 0; i < sizeof(T); i++)
                 val |= ((uint64_t)p[i]) << (i * 8);
         } else {
@@ -200,7 +274,7 @@ struct cursor {
     {
         std::uint64_t result = 0;
         int shift = 0;
-        while (pos < sec->end) {
+        while (pos < sec.end) {
             uint8_t byte = *(uint8_t *)(pos++);
             result |= (uint64_t)(byte & 0x7f) << shift;
             if ((byte & 0x80) == 0)
@@ -218,7 +292,7 @@ struct cursor {
      */
     taddr address()
     {
-        switch (sec->addr_size) {
+        switch (sec.addr_size) {
         case 1:
             return fixed<uint8_t>();
         case 2:
@@ -228,7 +302,7 @@ struct cursor {
         case 8:
             return fixed<uint64_t>();
         default:
-            throw std::runtime_error("address size " + std::to_string(sec->addr_size) + " not supported");
+            throw std::runtime_error("address size " + std::to_string(sec.addr_size) + " not supported");
         }
     }
     /**
@@ -270,7 +344,7 @@ struct cursor {
 
     bool end() const
     {
-        return pos >= sec->end;
+        return pos >= sec.end;
     }
 
     bool valid() const
@@ -285,11 +359,11 @@ struct cursor {
      */
     section_offset get_section_offset() const
     {
-        return pos - sec->begin;
+        return pos - sec.begin;
     }
 
   private:
-    cursor(const std::shared_ptr<section> sec, const char *pos)
+    cursor(const section_view &sec, const char *pos)
         : sec(sec), pos(pos) {}
     /**
      * @brief 当游标超出节的范围时，抛出异常
@@ -298,6 +372,415 @@ struct cursor {
     void underflow();
 };
 
+/**
+ * @brief 以C字符串内容（而不是指针）为键的哈希表使用的哈希函数
+ *
+ */
+struct string_hash {
+    typedef size_t result_type;
+    typedef const char *argument_type;
+    result_type operator()(const char *s) const
+    {
+        result_type h = 0;
+        for (; *s; ++s)
+            h += 33 * h + *s;
+        return h;
+    }
+};
+
+struct string_eq {
+    typedef bool result_type;
+    typedef const char *first_argument_type;
+    typedef const char *second_argument_type;
+    bool operator()(const char *x, const char *y) const
+    {
+        return strcmp(x, y) == 0;
+    }
+};
+
+/**
+ * @brief 字节串的哈希函数（djb2），用于索引中的开放寻址哈希表。
+ * 哈希值会被写入索引缓存，因此不能依赖 std::hash
+ *
+ */
+static inline uint32_t hash_bytes(const char *s, size_t len, uint32_t h = 5381)
+{
+    for (size_t i = 0; i < len; i++)
+        h = (h << 5) + h + (unsigned char)s[i];
+    return h;
+}
+
+/**
+ * @brief 索引使用的只读数组。数据来自构建索引时填充的 owned，
+ * 或者来自映射到内存的索引缓存文件，查询时只通过 data 和 size 访问
+ *
+ * @tparam T 必须可以按字节复制
+ */
+template <typename T>
+struct flat_array {
+    std::vector<T> owned;
+    const T *data = nullptr;
+    size_t size = 0;
+
+    /**
+     * @brief 构建完成后使数组指向 owned
+     *
+     */
+    void own()
+    {
+        owned.shrink_to_fit();
+        data = owned.data();
+        size = owned.size();
+    }
+
+    /**
+     * @brief 使数组指向外部的内存，如映射的缓存文件
+     *
+     */
+    void map(const T *p, size_t n)
+    {
+        owned.clear();
+        owned.shrink_to_fit();
+        data = p;
+        size = n;
+    }
+
+    const T &operator[](size_t i) const
+    {
+        return data[i];
+    }
+
+    const T *begin() const
+    {
+        return data;
+    }
+
+    const T *end() const
+    {
+        return data + size;
+    }
+};
+
+/**
+ * @brief 为 n 个元素构建线性探测的开放寻址哈希表，槽中保存元素下标加一，0 表示空槽。
+ * 同一个键的多个元素占用不同的槽
+ *
+ * @param n
+ * @param hash 返回第 i 个元素的哈希值
+ * @return std::vector<uint32_t> 大小为2的幂
+ */
+template <typename Hash>
+std::vector<uint32_t> build_slots(size_t n, Hash hash)
+{
+    size_t cap = 8;
+    while (cap < n * 2)
+        cap <<= 1;
+    std::vector<uint32_t> slots(cap);
+    for (size_t i = 0; i < n; i++) {
+        size_t slot = hash(i) & (cap - 1);
+        while (slots[slot])
+            slot = (slot + 1) & (cap - 1);
+        slots[slot] = i + 1;
+    }
+    return slots;
+}
+
+/**
+ * @brief 对哈希值为 h 的每个候选元素调用 visit(i)，直到遇到空槽或 visit 返回 false
+ *
+ */
+template <typename Visit>
+void probe_slots(const flat_array<uint32_t> &slots, uint32_t h, Visit visit)
+{
+    if (!slots.size)
+        return;
+    size_t mask = slots.size - 1;
+    for (size_t slot = h & mask, n = 0; n < slots.size && slots[slot];
+         slot = (slot + 1) & mask, n++)
+        if (!visit(slots[slot] - 1))
+            return;
+}
+
+/**
+ * @brief 检查从缓存读取的哈希表：槽的数量为0或2的幂，非空的槽指向 n 个元素之一
+ *
+ */
+inline bool check_slots(const flat_array<uint32_t> &slots, size_t n)
+{
+    if (slots.size & (slots.size - 1))
+        return false;
+    for (uint32_t v : slots)
+        if (v > n)
+            return false;
+    return true;
+}
+
+/**
+ * @brief 检查从缓存读取的字符串表以NUL结尾，使小于其大小的偏移量都指向完整的字符串
+ *
+ */
+inline bool check_strings(const flat_array<char> &strings)
+{
+    return !strings.size || strings[strings.size - 1] == '\0';
+}
+
+/**
+ * @brief 检查 [first, first + count) 在大小为 n 的数组中
+ *
+ */
+inline bool check_range(uint32_t first, uint32_t count, size_t n)
+{
+    return (uint64_t)first + count <= n;
+}
+
+/**
+ * @brief 索引缓存文件的写入器。每个数组前记录元素数量和元素大小，
+ * 数据按8字节对齐，读取时可以直接指向映射的文件
+ *
+ */
+struct index_writer {
+    std::string buf;
+
+    void u64(uint64_t v)
+    {
+        bytes(&v, sizeof(v));
+    }
+
+    void bytes(const void *data, size_t len)
+    {
+        buf.append((const char *)data, len);
+        buf.append((8 - len % 8) % 8, '\0');
+    }
+
+    template <typename T>
+    void array(const flat_array<T> &a)
+    {
+        u64(a.size);
+        u64(sizeof(T));
+        bytes(a.data, a.size * sizeof(T));
+    }
+};
+
+/**
+ * @brief 索引缓存文件的读取器，数组直接指向映射的内存，不复制
+ *
+ */
+struct index_reader {
+    const char *pos, *end;
+    // 映射的文件，读出的每个索引都持有它
+    std::shared_ptr<const void> mapping;
+
+    bool u64(uint64_t *out)
+    {
+        if (end - pos < 8)
+            return false;
+        memcpy(out, pos, 8);
+        pos += 8;
+        return true;
+    }
+
+    bool bytes(const char **out, size_t len)
+    {
+        size_t padded = len + (8 - len % 8) % 8;
+        if ((size_t)(end - pos) < padded)
+            return false;
+        *out = pos;
+        pos += padded;
+        return true;
+    }
+
+    template <typename T>
+    bool array(flat_array<T> *a)
+    {
+        uint64_t n, elem;
+        const char *data;
+        if (!u64(&n) || !u64(&elem) || elem != sizeof(T) ||
+            n > (uint64_t)(end - pos) / sizeof(T) || !bytes(&data, n * sizeof(T)))
+            return false;
+        a->map((const T *)data, n);
+        return true;
+    }
+};
+
+/**
+ * @brief .debug_types 中类型签名到类型单元偏移量的索引，按签名排序。
+ * 构建时只读取每个单元的头部，类型单元在第一次使用时才创建
+ *
+ */
+struct type_unit_index {
+    struct entry {
+        uint64_t signature;
+        section_offset offset;
+    };
+
+    flat_array<entry> entries;
+    // 从缓存加载时持有映射的文件
+    std::shared_ptr<const void> mapping;
+
+    type_unit_index() = default;
+
+    /**
+     * @brief 读取 dw 的 .debug_types 节，该节不存在时抛出format_error异常
+     *
+     */
+    explicit type_unit_index(const dwarf &dw);
+
+    /**
+     * @brief 查找签名为 signature 的类型单元在 entries 中的下标
+     *
+     * @return false 没有这个签名
+     */
+    bool find(uint64_t signature, size_t *out) const;
+};
+
+/**
+ * @brief 各个索引的序列化。每个索引在自己的源文件中实现读写，
+ * 文件头和映射在 index_cache.cpp 中实现。read 检查数组中的下标和范围，
+ * 缓存文件损坏时返回 false，不会在查询时越界
+ *
+ */
+struct index_cache {
+    static void write(const pc_index &idx, index_writer *w);
+    static void write(const aranges &idx, index_writer *w);
+    static void write(const name_index &idx, index_writer *w);
+    static void write(const line_index &idx, index_writer *w);
+    static void write(const type_unit_index &idx, index_writer *w);
+    static void write(const type_index &idx, index_writer *w);
+    static void write(const function_index &idx, index_writer *w);
+
+    static bool read(pc_index *idx, const dwarf &dw, index_reader *r);
+    static bool read(aranges *idx, const dwarf &dw, index_reader *r);
+    static bool read(name_index *idx, const dwarf &dw, index_reader *r);
+    static bool read(line_index *idx, const dwarf &dw, index_reader *r);
+    static bool read(type_unit_index *idx, index_reader *r);
+    static bool read(type_index *idx, const dwarf &dw, index_reader *r);
+    static bool read(function_index *idx, const dwarf &dw, index_reader *r);
+
+    /**
+     * @brief 映射缓存文件并检查文件头，返回的读取器指向第一个索引
+     *
+     * @param path
+     * @param key 必须与写入时的 key 相同
+     * @param dw 文件头中记录了 .debug_info 的大小和编译单元的数量
+     * @param out
+     * @return true 文件存在且有效
+     */
+    static bool open(const std::string &path, const std::string &key,
+                     const dwarf &dw, index_reader *out);
+
+    /**
+     * @brief 生成文件头
+     *
+     */
+    static void header(const std::string &key, const dwarf &dw, index_writer *w);
+
+    /**
+     * @brief 先写入临时文件再重命名，使并发的调试会话不会读到写了一半的文件
+     *
+     */
+    static bool commit(const index_writer &w, const std::string &path);
+};
+
+/**
+ * @brief 按编译单元分段构建索引。collect_* 只读取一个编译单元，
+ * 在所有单元的缩写表和根 DIE 都已解码后可以在多个线程上并行调用；
+ * merge_* 按编译单元的顺序合并各段，结果与串行构建的索引完全相同
+ *
+ */
+struct index_builder {
+    struct pc_part;
+    struct name_part;
+    struct line_part;
+    struct type_part;
+    struct function_part;
+
+    static std::shared_ptr<pc_part> collect_pcs(const dwarf &dw, uint32_t cu);
+    static pc_index merge_pcs(const dwarf &dw,
+                              const std::vector<std::shared_ptr<pc_part>> &parts);
+
+    /**
+     * @brief 读取 .debug_pubnames 和 .debug_pubtypes
+     *
+     * @param dw
+     * @param covered 记录出现在 .debug_pubnames 中的编译单元，这些单元只需要扫描非外部的名字
+     */
+    static std::shared_ptr<name_part> collect_pubnames(const dwarf &dw,
+                                                       std::vector<bool> *covered);
+    /**
+     * @brief 遍历编译单元 cu 的 DIE 树收集名字
+     *
+     * @param skip_external 跳过带 DW_AT_external 的 DIE，它们已经出现在 .debug_pubnames 中
+     */
+    static std::shared_ptr<name_part> collect_names(const dwarf &dw, uint32_t cu,
+                                                    bool skip_external);
+    static name_index merge_names(const dwarf &dw,
+                                  const std::vector<std::shared_ptr<name_part>> &parts);
+
+    /**
+     * @brief 收集一个单元中的类型名
+     *
+     * @param dw
+     * @param unit 小于编译单元数量时为编译单元的下标，否则减去编译单元数量后为类型单元的下标
+     */
+    static std::shared_ptr<type_part> collect_types(const dwarf &dw, uint32_t unit);
+    static type_index merge_types(const dwarf &dw,
+                                  const std::vector<std::shared_ptr<type_part>> &parts);
+
+    static std::shared_ptr<function_part> collect_functions(const dwarf &dw, uint32_t cu);
+    static function_index merge_functions(const dwarf &dw,
+                                          const std::vector<std::shared_ptr<function_part>> &parts);
+
+    static std::shared_ptr<line_part> collect_lines(const dwarf &dw, const pc_index &pcs,
+                                                    uint32_t cu);
+    static line_index merge_lines(const dwarf &dw,
+                                  const std::vector<std::shared_ptr<line_part>> &parts);
+};
+
+/**
+ * @brief 在 parallelism 个线程上对 [0, n) 中的每个下标调用 fn(i)，所有调用结束后返回。
+ * 每个线程先处理分给自己的一段连续下标，处理完后从剩余最多的线程末尾窃取一半。
+ * fn 抛出异常时不再开始新的调用，所有线程结束后重新抛出第一个异常
+ *
+ * @param n
+ * @param parallelism 为0时使用硬件线程数
+ * @param fn
+ */
+void parallel_for(size_t n, unsigned parallelism, const std::function<void(size_t)> &fn);
+
+/**
+ * @brief 库内部访问 die 私有成员的入口，die 的构造函数和 read 不对外公开
+ *
+ */
+struct die_access {
+    static die read(const unit *cu, section_offset off);
+};
+
+/**
+ * @brief 从编译单元 cu 中偏移为 off（相对于单元）的位置读取一个 DIE
+ *
+ * @param cu
+ * @param off
+ * @return die
+ */
+inline die read_die(const unit *cu, section_offset off)
+{
+    return die_access::read(cu, off);
+}
+
+/**
+ * @brief 返回作用域 DIE（命名空间、类、结构体或联合）在限定名中的名字，
+ * 匿名命名空间记作 "(anonymous namespace)"，匿名类型返回 false
+ *
+ */
+bool scope_name(const die &d, std::string *out);
+
+/**
+ * @brief 由 ref 外层的作用域组成限定名的前缀，从外到内保存在 out 中。
+ * 遇到不是作用域的外层 DIE（如函数）时停止，经过匿名类型时返回 false
+ *
+ */
+bool scope_names(die_ref ref, std::vector<std::string> *out);
+
 /**
  * An attribute specification in an abbrev.
  */
@@ -325,7 +808,16 @@ struct abbrev_entry {
     // 表示条目的属性规范列表
     std::vector<attribute_spec> attributes;
 
-    abbrev_entry() : code(0) {}
+    // 以下由 layout 计算。
+    // 前 fixed_count 个属性都是固定长度的，它们相对于第一个属性的偏移量保存在 offsets 中，
+    // 总长度为 fixed_size，读取DIE时可以一次跳过
+    unsigned fixed_count;
+    section_offset fixed_size;
+    std::vector<section_offset> offsets;
+    // 以属性名为键的开放寻址哈希表，槽中保存属性下标加一，0 表示空槽
+    std::vector<uint16_t> slots;
+
+    abbrev_entry() : code(0), fixed_count(0), fixed_size(0) {}
     /**
      * @brief 用于从给定的游标cur中读取条目的信息。
      * read函数首先清空attributes列表，然后
@@ -339,6 +831,74 @@ struct abbrev_entry {
      * @return false 
      */
     bool read(cursor *cur);
+
+    /**
+     * @brief 在 read 之后调用，根据单元的地址大小和格式计算
+     * 固定长度属性的偏移量和属性名的哈希表
+     *
+     * @param addr_size
+     * @param fmt
+     */
+    void layout(unsigned addr_size, format fmt);
+
+    /**
+     * @brief 返回属性 name 在 attributes 中的下标，没有该属性时返回 -1
+     *
+     * @param name
+     * @return int
+     */
+    int find(DW_AT name) const
+    {
+        if (slots.empty()) {
+            for (size_t i = 0; i < attributes.size(); i++)
+                if (attributes[i].name == name)
+                    return i;
+            return -1;
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t slot = slot_hash(name) & mask; slots[slot]; slot = (slot + 1) & mask)
+            if (attributes[slots[slot] - 1].name == name)
+                return slots[slot] - 1;
+        return -1;
+    }
+
+    static size_t slot_hash(DW_AT name)
+    {
+        return ((uint32_t)name * 2654435761u) >> 16;
+    }
+};
+
+/**
+ * @brief .debug_abbrev 中从某个偏移量开始的一个缩写表。构造后不再修改，
+ * 由 dwarf 按 (偏移量, 地址大小, 格式) 缓存，使用同一个表的单元共享同一个对象
+ *
+ */
+struct abbrev_table {
+    // 编码较密集时按编码直接索引，否则使用哈希表
+    std::vector<abbrev_entry> vec;
+    std::unordered_map<abbrev_code, abbrev_entry> map;
+
+    /**
+     * @brief 读取 sec 中从 offset 开始的缩写表，并按单元的地址大小和格式计算属性布局
+     *
+     */
+    abbrev_table(const std::shared_ptr<section> &sec, section_offset offset,
+                 unsigned addr_size, format fmt);
+
+    /**
+     * @brief 返回编码为 code 的缩写，不存在时返回空指针
+     *
+     */
+    const abbrev_entry *find(abbrev_code code) const
+    {
+        if (!vec.empty()) {
+            if (code >= vec.size() || vec[code].code == 0)
+                return nullptr;
+            return &vec[code];
+        }
+        auto it = map.find(code);
+        return it == map.end() ? nullptr : &it->second;
+    }
 };
 
 /**
@@ -355,8 +915,7 @@ struct name_unit {
     void read(cursor *cur)
     {
         // Section 7.19
-        std::shared_ptr<section> subsec = cur->subsection();
-        cursor sub(subsec);
+        cursor sub(cur->subview());
         sub.skip_initial_length();
         version = sub.fixed<uhalf>();
         if (version != 2)
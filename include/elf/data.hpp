@@ -174,6 +174,7 @@ enum class sht : ElfTypes::Word {
     shlib = 10,        // Reserved
     dynsym = 11,       // Contains a dynamic loader symbol table
     loos = 0x60000000, // Environment-specific use
+    gnu_hash = 0x6FFFFFF6, // GNU-style symbol hash table
     hios = 0x6FFFFFFF,
     loproc = 0x70000000, // Processor-specific use
     hiproc = 0x7FFFFFFF,
@@ -17,6 +17,8 @@ class section;
 class strtab;
 class symtab;
 class segment;
+class symbol_index;
+class symbolizer;
 
 /**
  * @brief ELF格式异常
@@ -34,6 +36,9 @@ class format_error : public std::runtime_error
 /**
  * @brief 表示一个ELF文件
  *
+ * 线程安全：同一个 elf 对象及其节可以同时在多个线程上查询，
+ * 惰性加载的节名、节数据、符号索引和地址查找表都只初始化一次
+ *
  */
 class elf
 {
@@ -113,6 +118,28 @@ class elf
      */
     const section &get_section(unsigned index) const;
 
+    /**
+     * @brief 返回 .note.gnu.build-id 中记录的构建ID的十六进制表示。
+     * 如果文件没有构建ID，则返回空字符串
+     *
+     * @return std::string
+     */
+    std::string get_build_id() const;
+
+    /**
+     * @brief 返回该文件的符号索引。索引在第一次调用时构建
+     *
+     * @return const symbol_index&
+     */
+    const symbol_index &get_symbol_index() const;
+
+    /**
+     * @brief 返回该文件的地址到符号的查找表。查找表在第一次调用时构建
+     *
+     * @return const symbolizer&
+     */
+    const symbolizer &get_symbolizer() const;
+
   private:
     struct impl;
     std::shared_ptr<impl> m;
@@ -489,6 +516,117 @@ class symtab
     struct impl;
     std::shared_ptr<impl> m;
 };
+
+/**
+ * @brief 符号查找的结果。name 直接指向字符串表中的数据，不以复制的方式返回
+ *
+ */
+struct symbol_ref {
+    const char *name;
+    size_t name_len;
+    Sym<> data;
+    // 符号所在的符号表的类型（dynsym 或 symtab）
+    sht table;
+};
+
+/**
+ * @brief 按名字查找符号的索引。
+ * .dynsym 使用文件中的 .gnu.hash 或 .hash 节查找，.symtab 以及 .gnu.hash 中没有的
+ * 未定义动态符号在构建时建立一次开放寻址哈希表。查找不分配内存
+ *
+ */
+class symbol_index
+{
+  public:
+    /**
+     * @brief 为 f 的 .dynsym 和 .symtab 构建索引
+     *
+     * @param f
+     */
+    explicit symbol_index(const elf &f);
+
+    symbol_index() = default;
+    symbol_index(const symbol_index &o) = default;
+    symbol_index(symbol_index &&o) = default;
+    symbol_index &operator=(const symbol_index &o) = default;
+    symbol_index &operator=(symbol_index &&o) = default;
+
+    bool valid() const
+    {
+        return !!m;
+    }
+
+    /**
+     * @brief 查找名字为 name 的符号，先 .dynsym 后 .symtab
+     *
+     * @param name 不需要以NUL结尾
+     * @param len name 的长度
+     * @param out 最多写入 max 个结果
+     * @param max
+     * @return size_t 匹配的符号总数，可能大于 max
+     */
+    size_t find(const char *name, size_t len, symbol_ref *out, size_t max) const;
+
+    /**
+     * @brief 返回索引中符号的数量
+     *
+     * @return size_t
+     */
+    size_t size() const;
+
+  private:
+    struct impl;
+    std::shared_ptr<impl> m;
+};
+
+/**
+ * @brief 按地址排序的符号表，用于在没有调试信息时把地址转换为"符号+偏移量"。
+ * 只包含有大小的已定义 STT_FUNC 和 STT_OBJECT 符号，优先使用 .symtab，
+ * 被strip的文件使用 .dynsym
+ *
+ */
+class symbolizer
+{
+  public:
+    /**
+     * @brief 遍历 f 的符号表一次构建查找表
+     *
+     * @param f
+     */
+    explicit symbolizer(const elf &f);
+
+    symbolizer() = default;
+    symbolizer(const symbolizer &o) = default;
+    symbolizer(symbolizer &&o) = default;
+    symbolizer &operator=(const symbolizer &o) = default;
+    symbolizer &operator=(symbolizer &&o) = default;
+
+    bool valid() const
+    {
+        return !!m;
+    }
+
+    /**
+     * @brief 二分查找包含地址 addr 的符号
+     *
+     * @param addr 链接时的地址（与符号值相同）
+     * @param out 包含 addr 的符号
+     * @param offset addr 相对于符号起始地址的偏移量
+     * @return true 找到了包含 addr 的符号
+     */
+    bool symbolize(Elf64::Addr addr, symbol_ref *out, Elf64::Off *offset) const;
+
+    /**
+     * @brief 返回查找表中符号的数量
+     *
+     * @return size_t
+     */
+    size_t size() const;
+
+  private:
+    struct impl;
+    std::shared_ptr<impl> m;
+};
 } // namespace elf
 
 #endif
\ No newline at end of file
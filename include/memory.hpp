@@ -0,0 +1,334 @@
+#ifndef MINIDBG_MEMORY_HPP
+#define MINIDBG_MEMORY_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace minidbg
+{
+/**
+ * @brief 被调试进程的内存读写。一次系统调用读写任意长度的内存：
+ * 优先使用 process_vm_readv/process_vm_writev，
+ * 它们不能写入只读页（如代码段），此时使用 /proc/<pid>/mem，
+ * 最后才逐字使用 PTRACE_PEEKDATA/PTRACE_POKEDATA。
+ *
+ * 读取以页为单位缓存，同一次停止中反复读取同一页（如回溯时的栈）只访问进程一次。
+ * 写入同时更新缓存。进程恢复执行前必须调用 invalidate。
+ *
+ * 通过 map_image 登记的只读段（如 .text 和 .rodata）直接从映射的 ELF 文件读取，
+ * 不访问进程。对这些段的写入（如断点指令）记录下来，读取时覆盖文件中的字节
+ *
+ */
+class process_memory
+{
+  public:
+    explicit process_memory(pid_t pid) : pid(pid), page_size(sysconf(_SC_PAGESIZE)) {}
+    process_memory(const process_memory &) = delete;
+    process_memory &operator=(const process_memory &) = delete;
+    ~process_memory()
+    {
+        if (mem_fd >= 0)
+            close(mem_fd);
+    }
+
+    /**
+     * @brief 读取 [addr, addr + len) 到 buf，无法访问时抛出 std::runtime_error
+     *
+     * @param addr
+     * @param buf
+     * @param len
+     */
+    inline void read(uint64_t addr, void *buf, size_t len);
+
+    /**
+     * @brief 将 buf 写入 [addr, addr + len)，无法访问时抛出 std::runtime_error
+     *
+     * @param addr
+     * @param buf
+     * @param len
+     */
+    inline void write(uint64_t addr, const void *buf, size_t len);
+
+    /**
+     * @brief 读取 addr 处 size 字节（不超过8）的小端序整数，高位补0
+     *
+     * @param addr
+     * @param size
+     * @return uint64_t
+     */
+    uint64_t read_value(uint64_t addr, unsigned size = sizeof(uint64_t))
+    {
+        uint64_t value = 0;
+        read(addr, &value, size < sizeof(value) ? size : sizeof(value));
+        return value;
+    }
+
+    void write_value(uint64_t addr, uint64_t value)
+    {
+        write(addr, &value, sizeof(value));
+    }
+
+    /**
+     * @brief 登记从 addr 开始的 len 字节与 data 相同且进程不会修改，之后从 data 读取。
+     * data 必须在 process_memory 的整个生存期内有效
+     *
+     * @param addr 运行时地址
+     * @param data
+     * @param len
+     */
+    void map_image(uint64_t addr, const void *data, size_t len)
+    {
+        images.push_back({addr, addr + len, static_cast<const uint8_t *>(data)});
+    }
+
+    /**
+     * @brief 丢弃缓存的所有页，进程恢复执行前调用
+     *
+     */
+    void invalidate()
+    {
+        pages.clear();
+    }
+
+    /**
+     * @brief 读取时在缓存中找到的页数
+     *
+     */
+    size_t hits() const
+    {
+        return n_hits;
+    }
+
+    /**
+     * @brief 读取时需要从进程读取的页数
+     *
+     */
+    size_t misses() const
+    {
+        return n_misses;
+    }
+
+    /**
+     * @brief 直接从 ELF 映像完成的读取次数
+     *
+     */
+    size_t image_reads() const
+    {
+        return n_image_reads;
+    }
+
+  private:
+    pid_t pid;
+    int mem_fd = -1;
+    uint64_t page_size;
+    // 以页的起始地址为键
+    std::unordered_map<uint64_t, std::vector<uint8_t>> pages;
+    size_t n_hits = 0, n_misses = 0, n_image_reads = 0;
+
+    struct image {
+        uint64_t begin, end;
+        const uint8_t *data;
+    };
+    std::vector<image> images;
+    // 写入只读段后与文件不同的字节
+    std::map<uint64_t, uint8_t> shadow;
+
+    inline void read_cached(uint64_t addr, void *buf, size_t len);
+    inline void read_uncached(uint64_t addr, void *buf, size_t len);
+    inline void write_uncached(uint64_t addr, const void *buf, size_t len);
+    inline int get_mem_fd();
+    /**
+     * @brief 将 [src_addr, src_addr + src_len) 与 [dst_addr, dst_addr + dst_len) 重叠的部分
+     * 从 src 复制到 dst
+     *
+     */
+    static inline void copy_overlap(uint64_t src_addr, const uint8_t *src, size_t src_len,
+                                    uint64_t dst_addr, uint8_t *dst, size_t dst_len);
+    [[noreturn]] inline void fail(uint64_t addr);
+};
+
+int process_memory::get_mem_fd()
+{
+    if (mem_fd < 0)
+        mem_fd = open(("/proc/" + std::to_string(pid) + "/mem").c_str(), O_RDWR);
+    return mem_fd;
+}
+
+void process_memory::fail(uint64_t addr)
+{
+    std::stringstream ss;
+    ss << "Cannot access memory at address 0x" << std::hex << addr;
+    throw std::runtime_error{ss.str()};
+}
+
+void process_memory::copy_overlap(uint64_t src_addr, const uint8_t *src, size_t src_len,
+                                  uint64_t dst_addr, uint8_t *dst, size_t dst_len)
+{
+    auto begin = std::max(src_addr, dst_addr);
+    auto end = std::min(src_addr + src_len, dst_addr + dst_len);
+    if (begin < end)
+        memcpy(dst + (begin - dst_addr), src + (begin - src_addr), end - begin);
+}
+
+void process_memory::read(uint64_t addr, void *buf, size_t len)
+{
+    auto out = static_cast<uint8_t *>(buf);
+    while (len > 0) {
+        // 找到包含 addr 的映像，或 addr 之后的第一个映像
+        const image *next = nullptr;
+        for (auto &img : images) {
+            if (img.end > addr && (!next || img.begin < next->begin))
+                next = &img;
+        }
+
+        size_t n;
+        if (next && next->begin <= addr) {
+            n = std::min<uint64_t>(len, next->end - addr);
+            memcpy(out, next->data + (addr - next->begin), n);
+            for (auto it = shadow.lower_bound(addr); it != shadow.end() && it->first < addr + n; ++it)
+                out[it->first - addr] = it->second;
+            ++n_image_reads;
+        } else {
+            n = next ? std::min<uint64_t>(len, next->begin - addr) : len;
+            read_cached(addr, out, n);
+        }
+        addr += n;
+        out += n;
+        len -= n;
+    }
+}
+
+void process_memory::read_cached(uint64_t addr, void *buf, size_t len)
+{
+    auto out = static_cast<uint8_t *>(buf);
+    auto end = addr + len;
+    for (auto page = addr & ~(page_size - 1); page < end;) {
+        auto it = pages.find(page);
+        if (it != pages.end()) {
+            ++n_hits;
+            copy_overlap(page, it->second.data(), page_size, addr, out, len);
+            page += page_size;
+            continue;
+        }
+
+        // 连续缺失的页一次读取。页是映射的最小单位，读取失败时请求的范围也无法完整读取
+        auto run_begin = page, run_end = page + page_size;
+        while (run_end < end && !pages.count(run_end))
+            run_end += page_size;
+        std::vector<uint8_t> data(run_end - run_begin);
+        try {
+            read_uncached(run_begin, data.data(), data.size());
+        } catch (std::runtime_error &) {
+            read_uncached(addr, buf, len);
+            return;
+        }
+        for (; page < run_end; page += page_size) {
+            ++n_misses;
+            auto src = data.data() + (page - run_begin);
+            pages[page].assign(src, src + page_size);
+            copy_overlap(page, src, page_size, addr, out, len);
+        }
+    }
+}
+
+void process_memory::write(uint64_t addr, const void *buf, size_t len)
+{
+    write_uncached(addr, buf, len);
+
+    auto in = static_cast<const uint8_t *>(buf);
+    for (auto page = addr & ~(page_size - 1); page < addr + len; page += page_size) {
+        auto it = pages.find(page);
+        if (it != pages.end())
+            copy_overlap(addr, in, len, page, it->second.data(), page_size);
+    }
+
+    // 只保留与文件不同的字节，断点被删除后对应的记录也随之删除
+    for (auto &img : images) {
+        auto begin = std::max(addr, img.begin);
+        auto end = std::min(addr + len, img.end);
+        for (auto a = begin; a < end; ++a) {
+            if (in[a - addr] == img.data[a - img.begin])
+                shadow.erase(a);
+            else
+                shadow[a] = in[a - addr];
+        }
+    }
+}
+
+void process_memory::read_uncached(uint64_t addr, void *buf, size_t len)
+{
+    auto out = static_cast<uint8_t *>(buf);
+    size_t done = 0;
+
+    // 遇到无法访问的页时只返回之前的部分，剩余部分交给后面的方法
+    struct iovec local{out, len}, remote{reinterpret_cast<void *>(addr), len};
+    auto n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+    if (n > 0)
+        done = n;
+
+    auto fd = get_mem_fd();
+    while (done < len && fd >= 0) {
+        n = pread(fd, out + done, len - done, addr + done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+
+    for (; done < len; done += sizeof(uint64_t)) {
+        errno = 0;
+        uint64_t word = ptrace(PTRACE_PEEKDATA, pid, addr + done, nullptr);
+        if (errno)
+            fail(addr + done);
+        memcpy(out + done, &word, std::min(sizeof(word), len - done));
+    }
+}
+
+void process_memory::write_uncached(uint64_t addr, const void *buf, size_t len)
+{
+    auto in = static_cast<const uint8_t *>(buf);
+    size_t done = 0;
+
+    struct iovec local{const_cast<uint8_t *>(in), len}, remote{reinterpret_cast<void *>(addr), len};
+    auto n = process_vm_writev(pid, &local, 1, &remote, 1, 0);
+    if (n > 0)
+        done = n;
+
+    // 被跟踪进程的 /proc/<pid>/mem 可以写入只读页
+    auto fd = get_mem_fd();
+    while (done < len && fd >= 0) {
+        n = pwrite(fd, in + done, len - done, addr + done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+
+    for (; done < len; done += sizeof(uint64_t)) {
+        auto size = std::min(sizeof(uint64_t), len - done);
+        uint64_t word = 0;
+        // 不足一个字时保留其余字节
+        if (size < sizeof(word)) {
+            errno = 0;
+            word = ptrace(PTRACE_PEEKDATA, pid, addr + done, nullptr);
+            if (errno)
+                fail(addr + done);
+        }
+        memcpy(&word, in + done, size);
+        if (ptrace(PTRACE_POKEDATA, pid, addr + done, word) < 0)
+            fail(addr + done);
+    }
+}
+} // namespace minidbg
+
+#endif
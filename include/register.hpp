@@ -1,10 +1,22 @@
 #ifndef FAULT_INJECT_REGISTER_HPP
 #define FAULT_INJECT_REGISTER_HPP
 
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+struct user_regs_struct;
+
 namespace minidbg
 {
 enum class reg;
-struct reg_descriptor;
+
+struct reg_descriptor {
+    reg r;
+    int dwarf_r; // 没有 DWARF 编号时为-1
+    const char *name;
+};
 
 /**
  * @brief 获取pid 的 reg 寄存器的值
@@ -24,6 +36,38 @@ uint64_t get_register_value(pid_t pid, reg r);
  */
 void set_register_value(pid_t pid, reg r, uint64_t value);
 
+/**
+ * @brief 用一次 ptrace 读取 pid 的所有通用寄存器
+ *
+ * @param pid
+ * @param regs
+ */
+void read_registers(pid_t pid, user_regs_struct *regs);
+
+/**
+ * @brief 用一次 ptrace 写入 pid 的所有通用寄存器
+ *
+ * @param pid
+ * @param regs
+ */
+void write_registers(pid_t pid, const user_regs_struct *regs);
+
+/**
+ * @brief 返回寄存器 r 在 user_regs_struct 中的下标（以 uint64_t 为单位）
+ *
+ * @param r
+ * @return std::size_t
+ */
+std::size_t get_register_index(reg r);
+
+/**
+ * @brief 从 DWARF 寄存器编号获取寄存器，未知的编号抛出 std::out_of_range
+ *
+ * @param regnum
+ * @return reg
+ */
+reg get_register_from_dwarf_register(unsigned regnum);
+
 /**
  * @brief 获取 寄存器 r 的字符串描述
  * 
@@ -33,7 +77,7 @@ void set_register_value(pid_t pid, reg r, uint64_t value);
 std::string get_register_name(reg r);
 
 /**
- * @brief 从寄存器名称获取寄存器
+ * @brief 从寄存器名称获取寄存器，未知的名称抛出 std::out_of_range
  * 
  * @param name 
  * @return reg 
@@ -65,4 +109,210 @@ int get_breakpoint_rollback();
 #error "unsupport the arch"
 #endif
 
+namespace minidbg
+{
+/**
+ * @brief 在编译期由 g_register_descriptors 生成的查找表，按寄存器、DWARF 编号和名称查找都是 O(1)。
+ * 表中的值是寄存器在 g_register_descriptors（即 user_regs_struct）中的下标
+ *
+ * @tparam N 寄存器数量
+ * @tparam NDwarf 最大的 DWARF 寄存器编号加1
+ */
+template <std::size_t N, std::size_t NDwarf>
+struct register_tables {
+    static constexpr std::size_t name_slots = 128;
+    static constexpr uint8_t none = 0xff;
+
+    // 按 reg 的值索引
+    uint8_t by_reg[N];
+    // 按 DWARF 寄存器编号索引
+    uint8_t by_dwarf[NDwarf];
+    // 名称的完美哈希表，name_seed 使所有名称的哈希值落在不同的槽中
+    uint8_t by_name[name_slots];
+    uint32_t name_seed;
+};
+
+constexpr uint32_t hash_register_name(const char *name, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (; *name; ++name) {
+        h ^= static_cast<unsigned char>(*name);
+        h *= 16777619u;
+    }
+    // FNV 的低位只由输入的低位决定，混合高位后再取模
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h;
+}
+
+template <std::size_t N>
+constexpr std::size_t dwarf_register_count(const std::array<reg_descriptor, N> &descs)
+{
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+        if (descs[i].dwarf_r >= 0 && static_cast<std::size_t>(descs[i].dwarf_r) >= n)
+            n = descs[i].dwarf_r + 1;
+    }
+    return n;
+}
+
+template <std::size_t NDwarf, std::size_t N>
+constexpr register_tables<N, NDwarf> make_register_tables(const std::array<reg_descriptor, N> &descs)
+{
+    using tables = register_tables<N, NDwarf>;
+    static_assert(N < tables::none, "too many registers");
+    tables t{};
+    for (std::size_t i = 0; i < N; ++i)
+        t.by_reg[i] = tables::none;
+    for (std::size_t i = 0; i < NDwarf; ++i)
+        t.by_dwarf[i] = tables::none;
+    for (std::size_t i = 0; i < N; ++i) {
+        t.by_reg[static_cast<std::size_t>(descs[i].r)] = i;
+        if (descs[i].dwarf_r >= 0)
+            t.by_dwarf[descs[i].dwarf_r] = i;
+    }
+
+    // 依次尝试种子，直到所有名称都没有冲突
+    for (uint32_t seed = 0;; ++seed) {
+        for (std::size_t i = 0; i < tables::name_slots; ++i)
+            t.by_name[i] = tables::none;
+        bool ok = true;
+        for (std::size_t i = 0; i < N && ok; ++i) {
+            auto slot = hash_register_name(descs[i].name, seed) % tables::name_slots;
+            ok = t.by_name[slot] == tables::none;
+            t.by_name[slot] = i;
+        }
+        if (ok) {
+            t.name_seed = seed;
+            return t;
+        }
+    }
+}
+
+static constexpr auto g_register_tables =
+    make_register_tables<dwarf_register_count(g_register_descriptors)>(g_register_descriptors);
+using register_tables_type = std::remove_const<decltype(g_register_tables)>::type;
+
+std::size_t get_register_index(reg r)
+{
+    return g_register_tables.by_reg[static_cast<std::size_t>(r)];
+}
+
+reg get_register_from_dwarf_register(unsigned regnum)
+{
+    if (regnum >= sizeof(g_register_tables.by_dwarf) ||
+        g_register_tables.by_dwarf[regnum] == register_tables_type::none) {
+        throw std::out_of_range{"Unknown dwarf register"};
+    }
+    return g_register_descriptors[g_register_tables.by_dwarf[regnum]].r;
+}
+
+std::string get_register_name(reg r)
+{
+    return g_register_descriptors[get_register_index(r)].name;
+}
+
+reg get_register_from_name(const std::string &name)
+{
+    auto slot = hash_register_name(name.c_str(), g_register_tables.name_seed) %
+                register_tables_type::name_slots;
+    auto i = g_register_tables.by_name[slot];
+    if (i == register_tables_type::none || name != g_register_descriptors[i].name) {
+        throw std::out_of_range{"Unknown register " + name};
+    }
+    return g_register_descriptors[i].r;
+}
+
+uint64_t get_register_value(pid_t pid, reg r)
+{
+    user_regs_struct regs;
+    read_registers(pid, &regs);
+    return *(reinterpret_cast<uint64_t *>(&regs) + get_register_index(r));
+}
+
+void set_register_value(pid_t pid, reg r, uint64_t value)
+{
+    user_regs_struct regs;
+    read_registers(pid, &regs);
+    *(reinterpret_cast<uint64_t *>(&regs) + get_register_index(r)) = value;
+    write_registers(pid, &regs);
+}
+
+uint64_t get_register_value_from_dwarf_register(pid_t pid, unsigned regnum)
+{
+    return get_register_value(pid, get_register_from_dwarf_register(regnum));
+}
+
+/**
+ * @brief 一个被跟踪线程的寄存器缓存。每次停止后第一次访问时用一次 ptrace 读取所有寄存器，
+ * 修改只写入缓存，恢复执行前调用 invalidate 一次性写回
+ *
+ */
+class register_cache
+{
+  public:
+    explicit register_cache(pid_t pid) : pid(pid) {}
+
+    uint64_t get(reg r)
+    {
+        fill();
+        return words()[get_register_index(r)];
+    }
+
+    void set(reg r, uint64_t value)
+    {
+        fill();
+        words()[get_register_index(r)] = value;
+        dirty = true;
+    }
+
+    uint64_t get_from_dwarf_register(unsigned regnum)
+    {
+        return get(get_register_from_dwarf_register(regnum));
+    }
+
+    /**
+     * @brief 有修改时写回线程
+     *
+     */
+    void flush()
+    {
+        if (dirty) {
+            write_registers(pid, &regs);
+            dirty = false;
+        }
+    }
+
+    /**
+     * @brief 写回修改并丢弃缓存，线程恢复执行前调用
+     *
+     */
+    void invalidate()
+    {
+        flush();
+        valid = false;
+    }
+
+  private:
+    pid_t pid;
+    user_regs_struct regs;
+    bool valid = false;
+    bool dirty = false;
+
+    void fill()
+    {
+        if (!valid) {
+            read_registers(pid, &regs);
+            valid = true;
+        }
+    }
+
+    uint64_t *words()
+    {
+        return reinterpret_cast<uint64_t *>(&regs);
+    }
+};
+} // namespace minidbg
+
 #endif
\ No newline at end of file
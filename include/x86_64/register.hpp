@@ -1,7 +1,7 @@
 #ifndef FAULT_INJECT_x86_REGISTER_HPP
 #define FAULT_INJECT_x86_REGISTER_HPP
 
-#include <algorithm>
+#include <array>
 #include <sys/user.h>
 
 namespace minidbg
@@ -39,14 +39,8 @@ enum class reg {
 
 static constexpr std::size_t n_registers = 27;
 
-struct reg_descriptor {
-    reg r;
-    int dwarf_r;
-    std::string name;
-};
-
 // have a look in /usr/include/sys/user.h for how to lay this out
-static const std::array<reg_descriptor, n_registers> g_register_descriptors{{
+static constexpr std::array<reg_descriptor, n_registers> g_register_descriptors{{
     {reg::r15, 15, "r15"},
     {reg::r14, 14, "r14"},
     {reg::r13, 13, "r13"},
@@ -76,52 +70,14 @@ static const std::array<reg_descriptor, n_registers> g_register_descriptors{{
     {reg::gs, 55, "gs"},
 }};
 
-uint64_t get_register_value(pid_t pid, reg r)
-{
-    user_regs_struct regs;
-    ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [r](auto &&rd) { return rd.r == r; });
-
-    return *(reinterpret_cast<uint64_t *>(&regs) + (it - begin(g_register_descriptors)));
-}
-
-void set_register_value(pid_t pid, reg r, uint64_t value)
-{
-    user_regs_struct regs;
-    ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [r](auto &&rd) { return rd.r == r; });
-
-    *(reinterpret_cast<uint64_t *>(&regs) + (it - begin(g_register_descriptors))) = value;
-    ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
-}
-
-uint64_t get_register_value_from_dwarf_register(pid_t pid, unsigned regnum)
-{
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [regnum](auto &&rd) {
-                               return static_cast<unsigned int>(rd.dwarf_r) == regnum;
-                           });
-    if (it == end(g_register_descriptors)) {
-        throw std::out_of_range{"Unknown dwarf register"};
-    }
-
-    return get_register_value(pid, it->r);
-}
-
-std::string get_register_name(reg r)
+void read_registers(pid_t pid, user_regs_struct *regs)
 {
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [r](auto &&rd) { return rd.r == r; });
-    return it->name;
+    ptrace(PTRACE_GETREGS, pid, nullptr, regs);
 }
 
-reg get_register_from_name(const std::string &name)
+void write_registers(pid_t pid, const user_regs_struct *regs)
 {
-    auto it = std::find_if(begin(g_register_descriptors), end(g_register_descriptors),
-                           [name](auto &&rd) { return rd.name == name; });
-    return it->r;
+    ptrace(PTRACE_SETREGS, pid, nullptr, regs);
 }
 
 int get_breakpoint_rollback()
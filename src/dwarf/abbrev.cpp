@@ -162,4 +162,98 @@ bool abbrev_entry::read(cursor *cur)
     attributes.shrink_to_fit();
     return true;
 }
+
+/**
+ * @brief 返回 form 的值在给定的地址大小和格式下的长度，变长的形式返回 false。
+ * 与 cursor::skip_form 跳过的长度一致
+ *
+ */
+static bool fixed_form_size(DW_FORM form, unsigned addr_size, format fmt, section_offset *out)
+{
+    switch (form) {
+    case DW_FORM::addr:
+        *out = addr_size;
+        return true;
+    case DW_FORM::sec_offset:
+    case DW_FORM::ref_addr:
+    case DW_FORM::strp:
+        if (fmt == format::unknown)
+            return false;
+        *out = fmt == format::dwarf32 ? 4 : 8;
+        return true;
+    case DW_FORM::flag_present:
+        *out = 0;
+        return true;
+    case DW_FORM::flag:
+    case DW_FORM::data1:
+    case DW_FORM::ref1:
+        *out = 1;
+        return true;
+    case DW_FORM::data2:
+    case DW_FORM::ref2:
+        *out = 2;
+        return true;
+    case DW_FORM::data4:
+    case DW_FORM::ref4:
+        *out = 4;
+        return true;
+    case DW_FORM::data8:
+    case DW_FORM::ref_sig8:
+        *out = 8;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void abbrev_entry::layout(unsigned addr_size, format fmt)
+{
+    offsets.clear();
+    fixed_size = 0;
+    for (auto &attr : attributes) {
+        section_offset size;
+        if (!fixed_form_size(attr.form, addr_size, fmt, &size))
+            break;
+        offsets.push_back(fixed_size);
+        fixed_size += size;
+    }
+    fixed_count = offsets.size();
+    offsets.shrink_to_fit();
+
+    // 属性太多时 find 退回到线性查找
+    slots.clear();
+    if (attributes.size() >= 0xffff)
+        return;
+    size_t cap = 4;
+    while (cap < attributes.size() * 2)
+        cap <<= 1;
+    slots.assign(cap, 0);
+    for (size_t i = 0; i < attributes.size(); i++) {
+        size_t slot = slot_hash(attributes[i].name) & (cap - 1);
+        while (slots[slot])
+            slot = (slot + 1) & (cap - 1);
+        slots[slot] = i + 1;
+    }
+}
+
+abbrev_table::abbrev_table(const shared_ptr<section> &sec, section_offset offset,
+                           unsigned addr_size, format fmt)
+{
+    cursor c(sec, offset);
+    abbrev_entry entry;
+    abbrev_code highest = 0;
+    while (entry.read(&c)) {
+        entry.layout(addr_size, fmt);
+        map[entry.code] = entry;
+        if (entry.code > highest)
+            highest = entry.code;
+    }
+
+    if (highest * 10 < map.size() * 15) {
+        vec.resize(highest + 1);
+        for (auto &entry : map)
+            vec[entry.first] = move(entry.second);
+        map.clear();
+    }
+}
 } // namespace dwarf
@@ -0,0 +1,206 @@
+#include "dwarf/internal.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace dwarf
+{
+
+struct aranges::impl {
+    // 地址范围 [low, high) 属于下标为 cu 的编译单元
+    struct range {
+        taddr low, high;
+        uint32_t cu;
+    };
+
+    const vector<compilation_unit> *units;
+    flat_array<range> ranges;
+    // 从索引缓存加载时保持映射的内存有效
+    shared_ptr<const void> mapping;
+
+    /**
+     * @brief 根据 .debug_info 中的偏移量查找编译单元的下标。
+     * 编译单元按偏移量递增排列，因此可以二分查找
+     *
+     * @param off
+     * @param out
+     * @return true 找到了以 off 开头的编译单元
+     */
+    bool find_unit(section_offset off, uint32_t *out) const
+    {
+        auto it = lower_bound(units->begin(), units->end(), off,
+                              [](const compilation_unit &cu, section_offset off) {
+                                  return cu.get_section_offset() < off;
+                              });
+        if (it == units->end() || it->get_section_offset() != off)
+            return false;
+        *out = it - units->begin();
+        return true;
+    }
+
+    /**
+     * @brief 读取 .debug_aranges 中的一组地址范围 (DWARF4 section 6.1.2)
+     *
+     * @param cur
+     * @param covered 记录出现在 .debug_aranges 中的编译单元
+     */
+    void read_set(cursor *cur, vector<bool> *covered)
+    {
+        cursor sub(cur->subview());
+        sub.skip_initial_length();
+        // 无法解析的一组只跳过自己，其编译单元没有被覆盖，改用根 DIE 的地址范围
+        uhalf version = sub.fixed<uhalf>();
+        if (version != 2)
+            return;
+        section_offset debug_info_offset = sub.offset();
+        ubyte address_size = sub.fixed<ubyte>();
+        ubyte segment_size = sub.fixed<ubyte>();
+        if (segment_size != 0)
+            return;
+        sub.sec.addr_size = address_size;
+
+        uint32_t cu;
+        if (!find_unit(debug_info_offset, &cu))
+            return;
+        (*covered)[cu] = true;
+
+        // 第一个地址范围按照两倍地址大小对齐
+        section_offset tuple_size = 2 * address_size;
+        section_offset off = sub.get_section_offset();
+        sub += (tuple_size - off % tuple_size) % tuple_size;
+
+        while (!sub.end()) {
+            taddr low = sub.address();
+            taddr length = sub.address();
+            if (low == 0 && length == 0)
+                break;
+            if (length)
+                ranges.owned.push_back({low, low + length, cu});
+        }
+    }
+
+    /**
+     * @brief 使用编译单元根 DIE 的地址范围代替 .debug_aranges
+     *
+     * @param cu
+     */
+    void synthesize(uint32_t cu)
+    {
+        const die &root = (*units)[cu].root();
+        if (root.has(DW_AT::ranges)) {
+            for (auto &r : die_range_table(root)->ranges)
+                ranges.owned.push_back({r.first, r.second, cu});
+            return;
+        }
+        if (!root.has(DW_AT::low_pc))
+            return;
+        taddr low = at_low_pc(root);
+        taddr high = root.has(DW_AT::high_pc) ? at_high_pc(root) : (low + 1);
+        if (low < high)
+            ranges.owned.push_back({low, high, cu});
+    }
+};
+
+aranges::aranges(const dwarf &dw)
+    : m(make_shared<impl>())
+{
+    m->units = &dw.compilation_units();
+    vector<bool> covered(m->units->size());
+
+    shared_ptr<section> sec;
+    try {
+        sec = dw.get_section(section_type::aranges);
+    } catch (format_error &e) {
+    }
+    if (sec) {
+        cursor cur(sec);
+        while (!cur.end())
+            m->read_set(&cur, &covered);
+    }
+    for (uint32_t i = 0; i < covered.size(); i++)
+        if (!covered[i])
+            m->synthesize(i);
+
+    // 按起始地址排序，起始地址相同时更长的范围在前
+    vector<impl::range> rs;
+    rs.swap(m->ranges.owned);
+    sort(rs.begin(), rs.end(), [](const impl::range &a, const impl::range &b) {
+        if (a.low != b.low)
+            return a.low < b.low;
+        return a.high > b.high;
+    });
+
+    // 扫描线：不同编译单元的范围可能重叠，重叠部分属于最后开始的范围，
+    // 它结束后恢复外层的范围。输出互不相交的范围，属于同一个编译单元的相邻范围合并
+    auto &out = m->ranges.owned;
+    auto emit = [&out](taddr low, taddr high, uint32_t cu) {
+        if (low >= high)
+            return;
+        if (!out.empty() && out.back().cu == cu && out.back().high == low)
+            out.back().high = high;
+        else
+            out.push_back({low, high, cu});
+    };
+    vector<const impl::range *> stack;
+    taddr pos = 0;
+    auto pop_until = [&](taddr addr) {
+        while (!stack.empty() && stack.back()->high <= addr) {
+            emit(pos, stack.back()->high, stack.back()->cu);
+            pos = stack.back()->high;
+            stack.pop_back();
+            // 已经被更晚开始的范围完全覆盖的范围也已经结束
+            while (!stack.empty() && stack.back()->high <= pos)
+                stack.pop_back();
+        }
+    };
+    for (auto &r : rs) {
+        pop_until(r.low);
+        if (!stack.empty())
+            emit(pos, r.low, stack.back()->cu);
+        pos = r.low;
+        stack.push_back(&r);
+    }
+    pop_until(~(taddr)0);
+    m->ranges.own();
+}
+
+const compilation_unit *aranges::find(taddr pc) const
+{
+    if (!m)
+        return nullptr;
+    auto &rs = m->ranges;
+    auto it = upper_bound(rs.begin(), rs.end(), pc,
+                          [](taddr pc, const impl::range &r) { return pc < r.low; });
+    if (it == rs.begin() || pc >= (it - 1)->high)
+        return nullptr;
+    return &(*m->units)[(it - 1)->cu];
+}
+
+size_t aranges::size() const
+{
+    return m ? m->ranges.size : 0;
+}
+
+void index_cache::write(const aranges &idx, index_writer *w)
+{
+    w->array(idx.m->ranges);
+}
+
+bool index_cache::read(aranges *idx, const dwarf &dw, index_reader *r)
+{
+    auto m = make_shared<aranges::impl>();
+    m->units = &dw.compilation_units();
+    m->mapping = r->mapping;
+    if (!r->array(&m->ranges))
+        return false;
+    // find 要求范围按地址排序且互不相交
+    for (size_t i = 0; i < m->ranges.size; i++) {
+        auto &range = m->ranges[i];
+        if (range.cu >= m->units->size() || range.low >= range.high ||
+            (i && range.low < m->ranges[i - 1].high))
+            return false;
+    }
+    idx->m = m;
+    return true;
+}
+
+} // namespace dwarf
@@ -1,4 +1,4 @@
-#include "dwarf/dwarf.hpp"
+#include "dwarf/internal.hpp"
 using namespace std;
 
 namespace dwarf
@@ -258,4 +258,22 @@ rangelist die_pc_range(const die &d)
     return rangelist({{low, high}});
 }
 
+shared_ptr<const range_table> die_range_table(const die &d)
+{
+    const unit &cu = d.get_unit();
+    const die &cudie = cu.root();
+    taddr cu_low_pc = cudie.has(DW_AT::low_pc) ? at_low_pc(cudie) : 0;
+    section_offset off = d[DW_AT::ranges].as_sec_offset();
+    return cu.get_dwarf().get_range_table(off, cu.data()->addr_size, cu_low_pc);
+}
+
+bool die_pc_contains(const die &d, taddr pc)
+{
+    if (d.has(DW_AT::ranges))
+        return die_range_table(d)->contains(pc);
+    taddr low = at_low_pc(d);
+    taddr high = d.has(DW_AT::high_pc) ? at_high_pc(d) : (low + 1);
+    return low <= pc && pc < high;
+}
+
 } // namespace dwarf
\ No newline at end of file
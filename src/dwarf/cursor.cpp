@@ -10,7 +10,7 @@ int64_t cursor::sleb128()
 {
     uint64_t result = 0;
     unsigned shift = 0;
-    while (pos < sec->end) {
+    while (pos < sec.end) {
         uint8_t byte = *(uint8_t *)(pos++);
         result |= (uint64_t)(byte & 0x7f) << shift;
         shift += 7;
@@ -26,7 +26,12 @@ int64_t cursor::sleb128()
 
 shared_ptr<section> cursor::subsection()
 {
+    section_view sub = subview();
+    return make_shared<section>(sub.type, sub.begin, sub.size(), sub.ord, sub.fmt);
+}
 
+section_view cursor::subview()
+{
     const char *begin = pos;
     section_length length = fixed<uword>();
     format fmt;
@@ -41,12 +46,17 @@ shared_ptr<section> cursor::subsection()
         throw format_error("initial length has reserved value");
     }
     pos = begin + length;
-    return make_shared<section>(sec->type, begin, length, sec->ord, fmt);
+    section_view sub(sec);
+    sub.begin = begin;
+    sub.end = begin + length;
+    sub.fmt = fmt;
+    sub.addr_size = 0;
+    return sub;
 }
 
 void cursor::skip_initial_length()
 {
-    switch (sec->fmt) {
+    switch (sec.fmt) {
     case format::dwarf32:
         pos += sizeof(uword);
         break;
@@ -65,7 +75,7 @@ void cursor::skip_unit_type()
 
 section_offset cursor::offset()
 {
-    switch (sec->fmt) {
+    switch (sec.fmt) {
     case format::dwarf32:
         return fixed<uint32_t>();
     case format::dwarf64:
@@ -86,9 +96,9 @@ void cursor::string(std::string &out)
 const char * cursor::cstr(size_t *size_out)
 {
     const char *p = pos;
-    while (pos < sec->end && *pos)
+    while (pos < sec.end && *pos)
         pos++;
-    if (pos == sec->end)
+    if (pos == sec.end)
         throw format_error("unterminated string");
     if (size_out)
         *size_out = pos - p;
@@ -101,12 +111,12 @@ void cursor::skip_form(DW_FORM form)
     section_offset tmp;
     switch (form) {
     case DW_FORM::addr:
-        pos += sec->addr_size;
+        pos += sec.addr_size;
         break;
     case DW_FORM::sec_offset:
     case DW_FORM::ref_addr:
     case DW_FORM::strp:
-        switch (sec->fmt) {
+        switch (sec.fmt) {
         case format::dwarf32:
             pos += 4;
             break;
@@ -160,12 +170,12 @@ void cursor::skip_form(DW_FORM form)
     case DW_FORM::sdata:
     case DW_FORM::udata:
     case DW_FORM::ref_udata:
-        while (pos < sec->end && (*(uint8_t *)pos & 0x80))
+        while (pos < sec.end && (*(uint8_t *)pos & 0x80))
             pos++;
         pos++;
         break;
     case DW_FORM::string:
-        while (pos < sec->end && *pos)
+        while (pos < sec.end && *pos)
             pos++;
         pos++;
         break;
@@ -34,35 +34,44 @@ void die::read(section_offset off)
     // 获取对应的缩写条目，并将其地址存储在abbrev指针中
     abbrev = &cu->get_abbrev(acode);
     tag = abbrev->tag;
+    // 固定长度的前缀一次跳过，只记录之后的变长属性的偏移量
+    attr_start = cur.get_section_offset();
+    cur += abbrev->fixed_size;
     attrs.clear();
-    attrs.reserve(abbrev->attributes.size());
-    for (auto &attr : abbrev->attributes) {
+    attrs.reserve(abbrev->attributes.size() - abbrev->fixed_count);
+    for (size_t i = abbrev->fixed_count; i < abbrev->attributes.size(); i++) {
         attrs.push_back(cur.get_section_offset());
-        cur.skip_form(attr.form);
+        cur.skip_form(abbrev->attributes[i].form);
     }
     // 获取下一个die对象的偏移量
     next = cur.get_section_offset();
 }
 
+section_offset die::attr_offset(unsigned i) const
+{
+    if (i < abbrev->fixed_count)
+        return attr_start + abbrev->offsets[i];
+    return attrs[i - abbrev->fixed_count];
+}
+
+die die_access::read(const unit *cu, section_offset off)
+{
+    die d(cu);
+    d.read(off);
+    return d;
+}
+
 bool die::has(DW_AT attr) const
 {
-    if (!abbrev)
-        return false;
-    for (auto &a : abbrev->attributes)
-        if (a.name == attr)
-            return true;
-    return false;
+    return abbrev && abbrev->find(attr) >= 0;
 }
 
 value die::operator[](DW_AT attr) const
 {
-    if (abbrev) {
-        int i = 0;
-        for (auto &a : abbrev->attributes) {
-            if (a.name == attr)
-                return value(cu, a.name, a.form, a.type, attrs[i]);
-            i++;
-        }
+    int i = abbrev ? abbrev->find(attr) : -1;
+    if (i >= 0) {
+        auto &a = abbrev->attributes[i];
+        return value(cu, a.name, a.form, a.type, attr_offset(i));
     }
     throw out_of_range("DIE does not have attribute " + to_string(attr));
 }
@@ -133,7 +142,7 @@ const vector<pair<DW_AT, value>> die::attributes() const
 
     int i = 0;
     for (auto &a : abbrev->attributes) {
-        res.push_back(make_pair(a.name, value(cu, a.name, a.form, a.type, attrs[i])));
+        res.push_back(make_pair(a.name, value(cu, a.name, a.form, a.type, attr_offset(i))));
         i++;
     }
     return res;
@@ -19,28 +19,6 @@ struct hash<dwarf::DW_TAG> {
 
 namespace dwarf
 {
-struct string_hash {
-    typedef size_t result_type;
-    typedef const char *argument_type;
-    result_type operator()(const char *s) const
-    {
-        result_type h = 0;
-        for (; *s; ++s)
-            h += 33 * h + *s;
-        return h;
-    }
-};
-
-struct string_eq {
-    typedef bool result_type;
-    typedef const char *first_argument_type;
-    typedef const char *second_argument_type;
-    bool operator()(const char *x, const char *y) const
-    {
-        return strcmp(x, y) == 0;
-    }
-};
-
 struct die_str_map::impl {
     impl(const die &parent, DW_AT attr,
          const initializer_list<DW_TAG> &accept)
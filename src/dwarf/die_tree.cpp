@@ -0,0 +1,178 @@
+#include "dwarf/internal.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace dwarf
+{
+
+// 表示没有父节点、子节点或兄弟节点
+static const uint32_t no_die = ~(uint32_t)0;
+
+struct die_tree::impl {
+    const unit *cu;
+    vector<DW_TAG> tags;
+    vector<const abbrev_entry *> abbrevs;
+    // 相对于单元的偏移量，按先序递增
+    vector<section_offset> offsets;
+    vector<uint32_t> parents;
+    vector<uint32_t> first_children;
+    vector<uint32_t> next_siblings;
+    vector<uint32_t> depths;
+
+    uint32_t size() const
+    {
+        return tags.size();
+    }
+};
+
+die_tree::die_tree(const unit &u)
+    : m(make_shared<impl>())
+{
+    // die 对象保存的是第一次读取根 DIE 的单元的地址，这里保持一致
+    const die &root = u.root();
+    m->cu = &root.get_unit();
+
+    // 每一层的父节点和该层中最后一个已读取的DIE
+    struct level {
+        uint32_t parent, last;
+    };
+    vector<level> stack;
+    cursor cur(m->cu->data(), root.get_unit_offset());
+    while (!cur.end()) {
+        section_offset off = cur.get_section_offset();
+        abbrev_code acode = cur.uleb128();
+        if (acode == 0) {
+            // 兄弟列表的终止符，回到上一层
+            if (stack.empty())
+                break;
+            stack.pop_back();
+            if (stack.empty())
+                break;
+            continue;
+        }
+
+        const abbrev_entry &abbrev = m->cu->get_abbrev(acode);
+        uint32_t idx = m->size();
+        uint32_t parent = no_die;
+        if (!stack.empty()) {
+            level &top = stack.back();
+            parent = top.parent;
+            if (top.last == no_die)
+                m->first_children[parent] = idx;
+            else
+                m->next_siblings[top.last] = idx;
+            top.last = idx;
+        }
+        m->tags.push_back(abbrev.tag);
+        m->abbrevs.push_back(&abbrev);
+        m->offsets.push_back(off);
+        m->parents.push_back(parent);
+        m->first_children.push_back(no_die);
+        m->next_siblings.push_back(no_die);
+        m->depths.push_back(stack.size());
+
+        cur += abbrev.fixed_size;
+        for (size_t i = abbrev.fixed_count; i < abbrev.attributes.size(); i++)
+            cur.skip_form(abbrev.attributes[i].form);
+        if (abbrev.children)
+            stack.push_back({idx, no_die});
+        else if (stack.empty())
+            break;
+    }
+}
+
+size_t die_tree::size() const
+{
+    return m ? m->size() : 0;
+}
+
+die_ref die_tree::at(size_t i) const
+{
+    if (!m || i >= m->size())
+        return die_ref();
+    return die_ref(m.get(), i);
+}
+
+die_ref die_tree::find(section_offset off) const
+{
+    if (!m)
+        return die_ref();
+    auto it = lower_bound(m->offsets.begin(), m->offsets.end(), off);
+    if (it == m->offsets.end() || *it != off)
+        return die_ref();
+    return die_ref(m.get(), it - m->offsets.begin());
+}
+
+die_tree::iterator die_tree::begin() const
+{
+    if (!m || !m->size())
+        return end();
+    return iterator(die_ref(m.get(), 0));
+}
+
+die_tree::iterator die_tree::end() const
+{
+    if (!m)
+        return iterator();
+    return iterator(die_ref(m.get(), m->size()));
+}
+
+DW_TAG die_ref::tag() const
+{
+    return tree->tags[idx];
+}
+
+unsigned die_ref::depth() const
+{
+    return tree->depths[idx];
+}
+
+section_offset die_ref::get_unit_offset() const
+{
+    return tree->offsets[idx];
+}
+
+bool die_ref::has(DW_AT attr) const
+{
+    return tree->abbrevs[idx]->find(attr) >= 0;
+}
+
+die_ref die_ref::parent() const
+{
+    if (!tree)
+        return die_ref();
+    uint32_t i = tree->parents[idx];
+    return i == no_die ? die_ref() : die_ref(tree, i);
+}
+
+die_ref die_ref::first_child() const
+{
+    if (!tree)
+        return die_ref();
+    uint32_t i = tree->first_children[idx];
+    return i == no_die ? die_ref() : die_ref(tree, i);
+}
+
+die_ref die_ref::next_sibling() const
+{
+    if (!tree)
+        return die_ref();
+    uint32_t i = tree->next_siblings[idx];
+    return i == no_die ? die_ref() : die_ref(tree, i);
+}
+
+uint32_t die_ref::subtree_end() const
+{
+    // 子树之后是该DIE或其最近的祖先的下一个兄弟节点
+    for (uint32_t i = idx; i != no_die; i = tree->parents[i])
+        if (tree->next_siblings[i] != no_die)
+            return tree->next_siblings[i];
+    return tree->size();
+}
+
+die die_ref::get() const
+{
+    return read_die(tree->cu, tree->offsets[idx]);
+}
+
+} // namespace dwarf
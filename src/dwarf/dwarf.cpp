@@ -1,4 +1,8 @@
 #include "dwarf/internal.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <tuple>
 using namespace std;
 
 namespace dwarf
@@ -6,7 +10,7 @@ namespace dwarf
 
 struct dwarf::impl {
     impl(const std::shared_ptr<loader> &l)
-        : l(l), have_type_units(false) {}
+        : l(l) {}
 
     std::shared_ptr<loader> l;
 
@@ -14,11 +18,73 @@ struct dwarf::impl {
     std::shared_ptr<section> sec_abbrev;
 
     std::vector<compilation_unit> compilation_units;
+    // 各编译单元在 .debug_info 中的偏移量，按升序排列，与 compilation_units 一一对应
+    std::vector<section_offset> unit_offsets;
+
+    // 类型签名索引，从缓存加载时 have_type_unit_index 为 true
+    type_unit_index tu_index;
+    bool have_type_unit_index = false;
+    std::once_flag type_units_once;
+    // 与 tu_index.entries 一一对应，第一次使用时创建
+    std::unique_ptr<type_unit[]> type_units;
+    std::unique_ptr<std::once_flag[]> type_unit_once;
+
+    // 按需加载的节，下标为 section_type，节不存在时为空
+    static const size_t section_count = (size_t)section_type::types + 1;
+    std::shared_ptr<section> sections[section_count];
+    std::once_flag sections_once[section_count];
+
+    // 按 (偏移量, 地址大小, 格式) 缓存的缩写表
+    std::map<std::tuple<section_offset, unsigned, format>,
+             std::shared_ptr<const abbrev_table>>
+        abbrev_tables;
+    std::mutex abbrev_tables_lock;
+
+    // 按 (偏移量, 地址大小, 基地址) 缓存的已排序范围列表
+    std::map<std::tuple<section_offset, unsigned, taddr>,
+             std::shared_ptr<const range_table>>
+        range_tables;
+    std::mutex range_tables_lock;
+
+    // DW_FORM::ref_addr 引用的DIE，以 .debug_info 中的偏移量为键
+    std::unordered_map<section_offset, die> ref_addr_dies;
+    std::mutex ref_addr_dies_lock;
+
+    pc_index pcs;
+    aranges ars;
+    line_index lines;
+    name_index names;
+    type_index types;
+    function_index functions;
+    std::once_flag pcs_once, ars_once, lines_once, names_once, types_once, functions_once;
+
+    /**
+     * @brief 构建类型签名索引，只读取类型单元的头部。
+     * 没有从缓存加载索引且 .debug_types 不存在时抛出format_error异常
+     *
+     */
+    void force_type_units(const dwarf &file)
+    {
+        std::call_once(type_units_once, [&] {
+            if (!have_type_unit_index)
+                tu_index = type_unit_index(file);
+            size_t n = tu_index.entries.size;
+            type_units.reset(new type_unit[n]);
+            type_unit_once.reset(new std::once_flag[n]);
+        });
+    }
 
-    std::unordered_map<uint64_t, type_unit> type_units;
-    bool have_type_units;
-
-    std::map<section_type, std::shared_ptr<section>> sections;
+    /**
+     * @brief 返回签名索引中第 i 个类型单元，第一次调用时创建
+     *
+     */
+    const type_unit &get_type_unit(const dwarf &file, size_t i)
+    {
+        std::call_once(type_unit_once[i], [&] {
+            type_units[i] = type_unit(file, tu_index.entries[i].offset);
+        });
+        return type_units[i];
+    }
 };
 
 dwarf::dwarf(const std::shared_ptr<loader> &l)
@@ -54,6 +120,7 @@ dwarf::dwarf(const std::shared_ptr<loader> &l)
     // 用来遍历`m->sec_info`节中的编译单元
     cursor infocur(m->sec_info);
     while (!infocur.end()) {
+        m->unit_offsets.push_back(infocur.get_section_offset());
         m->compilation_units.emplace_back(
             *this, infocur.get_section_offset());
         // 定位到下一个编译单元的开头
@@ -72,18 +139,267 @@ dwarf::compilation_units() const
 
 const type_unit & dwarf::get_type_unit(uint64_t type_signature) const
 {
-    if (!m->have_type_units) {
-        cursor tucur(get_section(section_type::types));
-        while (!tucur.end()) {
-            type_unit tu(*this, tucur.get_section_offset());
-            m->type_units[tu.get_type_signature()] = tu;
-            tucur.subsection();
+    m->force_type_units(*this);
+    size_t i;
+    if (!m->tu_index.find(type_signature, &i))
+        throw out_of_range("type signature 0x" + to_hex(type_signature));
+    return m->get_type_unit(*this, i);
+}
+
+size_t dwarf::type_unit_count() const
+{
+    try {
+        m->force_type_units(*this);
+    } catch (format_error &e) {
+        return 0;
+    }
+    return m->tu_index.entries.size;
+}
+
+const type_unit &dwarf::get_type_unit_at(size_t i) const
+{
+    m->force_type_units(*this);
+    return m->get_type_unit(*this, i);
+}
+
+const pc_index &dwarf::get_pc_index() const
+{
+    std::call_once(m->pcs_once, [this] {
+        if (!m->pcs.valid())
+            m->pcs = pc_index(*this);
+    });
+    return m->pcs;
+}
+
+const aranges &dwarf::get_aranges() const
+{
+    std::call_once(m->ars_once, [this] {
+        if (!m->ars.valid())
+            m->ars = aranges(*this);
+    });
+    return m->ars;
+}
+
+const line_index &dwarf::get_line_index() const
+{
+    std::call_once(m->lines_once, [this] {
+        if (!m->lines.valid())
+            m->lines = line_index(*this);
+    });
+    return m->lines;
+}
+
+const name_index &dwarf::get_name_index() const
+{
+    std::call_once(m->names_once, [this] {
+        if (!m->names.valid())
+            m->names = name_index(*this);
+    });
+    return m->names;
+}
+
+const type_index &dwarf::get_type_index() const
+{
+    std::call_once(m->types_once, [this] {
+        if (!m->types.valid())
+            m->types = type_index(*this);
+    });
+    return m->types;
+}
+
+const function_index &dwarf::get_function_index() const
+{
+    std::call_once(m->functions_once, [this] {
+        if (!m->functions.valid())
+            m->functions = function_index(*this);
+    });
+    return m->functions;
+}
+
+void dwarf::preload(unsigned parallelism) const
+{
+    // 先串行地加载可选的节和类型签名索引，之后并行的解码只读取
+    // m->sections 和 m->tu_index，不会再修改它们
+    static const section_type optional[] = {
+        section_type::line, section_type::str, section_type::ranges,
+        section_type::loc, section_type::pubnames, section_type::pubtypes,
+        section_type::aranges, section_type::types};
+    for (auto type : optional) {
+        try {
+            get_section(type);
+        } catch (format_error &e) {
         }
-        m->have_type_units = true;
     }
-    if (!m->type_units.count(type_signature))
-        throw out_of_range("type signature 0x" + to_hex(type_signature));
-    return m->type_units[type_signature];
+    try {
+        m->force_type_units(*this);
+    } catch (format_error &e) {
+    }
+
+    // 解码每个单元的缩写表和根 DIE，以及编译单元的行号表。
+    // 每个任务只修改自己的单元，完成后其他单元的 DIE 可以在任何线程上读取
+    auto &cus = m->compilation_units;
+    size_t tus = m->type_units ? m->tu_index.entries.size : 0;
+    parallel_for(cus.size() + tus, parallelism, [&](size_t i) {
+        if (i < cus.size()) {
+            cus[i].get_materialized_line_table();
+        } else {
+            auto &tu = m->get_type_unit(*this, i - cus.size());
+            tu.root();
+            tu.type();
+        }
+    });
+
+    // 分编译单元收集地址索引和名字索引，再按单元的顺序合并。
+    // 已经构建或从缓存加载的索引不再构建
+    bool want_pcs = !m->pcs.valid(), want_names = !m->names.valid();
+    bool want_functions = !m->functions.valid();
+    vector<shared_ptr<index_builder::pc_part>> pc_parts(want_pcs ? cus.size() : 0);
+    vector<shared_ptr<index_builder::function_part>> function_parts(want_functions ? cus.size() : 0);
+    vector<shared_ptr<index_builder::name_part>> name_parts(want_names ? cus.size() + 1 : 0);
+    vector<bool> covered(cus.size(), false);
+    if (want_names)
+        name_parts[0] = index_builder::collect_pubnames(*this, &covered);
+    parallel_for(cus.size(), parallelism, [&](size_t i) {
+        if (want_pcs)
+            pc_parts[i] = index_builder::collect_pcs(*this, i);
+        if (want_names)
+            name_parts[i + 1] = index_builder::collect_names(*this, i, covered[i]);
+        if (want_functions)
+            function_parts[i] = index_builder::collect_functions(*this, i);
+    });
+    if (want_pcs)
+        m->pcs = index_builder::merge_pcs(*this, pc_parts);
+    if (want_names) {
+        name_parts.erase(remove(name_parts.begin(), name_parts.end(), nullptr), name_parts.end());
+        m->names = index_builder::merge_names(*this, name_parts);
+    }
+    if (want_functions)
+        m->functions = index_builder::merge_functions(*this, function_parts);
+    if (!m->ars.valid())
+        m->ars = aranges(*this);
+
+    // 类型名索引包括类型单元，单元的下标在编译单元之后
+    if (!m->types.valid()) {
+        vector<shared_ptr<index_builder::type_part>> type_parts(cus.size() + tus);
+        parallel_for(type_parts.size(), parallelism, [&](size_t i) {
+            type_parts[i] = index_builder::collect_types(*this, i);
+        });
+        m->types = index_builder::merge_types(*this, type_parts);
+    }
+
+    // 行号索引按函数对行分组，需要完整的地址索引
+    if (!m->lines.valid()) {
+        vector<shared_ptr<index_builder::line_part>> line_parts(cus.size());
+        parallel_for(cus.size(), parallelism, [&](size_t i) {
+            line_parts[i] = index_builder::collect_lines(*this, m->pcs, i);
+        });
+        m->lines = index_builder::merge_lines(*this, line_parts);
+    }
+}
+
+bool dwarf::load_index_cache(const std::string &path, const std::string &key) const
+{
+    index_reader r;
+    if (!index_cache::open(path, key, *this, &r))
+        return false;
+
+    pc_index pcs;
+    aranges ars;
+    name_index names;
+    line_index lines;
+    type_unit_index tus;
+    type_index types;
+    function_index functions;
+    if (!index_cache::read(&pcs, *this, &r) || !index_cache::read(&ars, *this, &r) ||
+        !index_cache::read(&names, *this, &r) || !index_cache::read(&lines, *this, &r) ||
+        !index_cache::read(&tus, &r) || !index_cache::read(&types, *this, &r) ||
+        !index_cache::read(&functions, *this, &r))
+        return false;
+    m->pcs = pcs;
+    m->ars = ars;
+    m->names = names;
+    m->lines = lines;
+    m->types = types;
+    m->functions = functions;
+    // 类型单元已经创建后不再替换签名索引
+    if (!m->type_units) {
+        m->tu_index = tus;
+        m->have_type_unit_index = true;
+    }
+    return true;
+}
+
+bool dwarf::save_index_cache(const std::string &path, const std::string &key) const
+{
+    index_writer w;
+    index_cache::header(key, *this, &w);
+    index_cache::write(get_pc_index(), &w);
+    index_cache::write(get_aranges(), &w);
+    index_cache::write(get_name_index(), &w);
+    index_cache::write(get_line_index(), &w);
+    // 没有 .debug_types 时写入空的签名索引
+    try {
+        m->force_type_units(*this);
+    } catch (format_error &e) {
+    }
+    index_cache::write(m->tu_index, &w);
+    index_cache::write(get_type_index(), &w);
+    index_cache::write(get_function_index(), &w);
+    return index_cache::commit(w, path);
+}
+
+std::shared_ptr<const abbrev_table>
+dwarf::get_abbrev_table(section_offset offset, const section &unit_data) const
+{
+    auto key = std::make_tuple(offset, unit_data.addr_size, unit_data.fmt);
+    {
+        std::lock_guard<std::mutex> guard(m->abbrev_tables_lock);
+        auto it = m->abbrev_tables.find(key);
+        if (it != m->abbrev_tables.end())
+            return it->second;
+    }
+    // 在锁外解析，使不同的表可以并行解析。两个线程同时解析同一个表时保留先插入的
+    auto table = std::make_shared<const abbrev_table>(m->sec_abbrev, offset,
+                                                      unit_data.addr_size, unit_data.fmt);
+    std::lock_guard<std::mutex> guard(m->abbrev_tables_lock);
+    return m->abbrev_tables.emplace(key, table).first->second;
+}
+
+std::shared_ptr<const range_table>
+dwarf::get_range_table(section_offset offset, unsigned addr_size, taddr base_addr) const
+{
+    auto key = std::make_tuple(offset, addr_size, base_addr);
+    {
+        std::lock_guard<std::mutex> guard(m->range_tables_lock);
+        auto it = m->range_tables.find(key);
+        if (it != m->range_tables.end())
+            return it->second;
+    }
+    rangelist rl(get_section(section_type::ranges), offset, addr_size, base_addr);
+    auto table = std::make_shared<const range_table>(rl);
+    std::lock_guard<std::mutex> guard(m->range_tables_lock);
+    return m->range_tables.emplace(key, table).first->second;
+}
+
+die dwarf::resolve_ref_addr(section_offset offset) const
+{
+    {
+        std::lock_guard<std::mutex> guard(m->ref_addr_dies_lock);
+        auto it = m->ref_addr_dies.find(offset);
+        if (it != m->ref_addr_dies.end())
+            return it->second;
+    }
+
+    // 最后一个起始偏移量不大于offset的编译单元
+    auto &offsets = m->unit_offsets;
+    auto it = std::upper_bound(offsets.begin(), offsets.end(), offset);
+    if (it == offsets.begin() || offset >= m->sec_info->size())
+        throw format_error("reference to 0x" + to_hex(offset) + " is outside .debug_info");
+    const compilation_unit &cu = m->compilation_units[it - offsets.begin() - 1];
+    die d = read_die(&cu, offset - cu.get_section_offset());
+
+    std::lock_guard<std::mutex> guard(m->ref_addr_dies_lock);
+    return m->ref_addr_dies.emplace(offset, d).first->second;
 }
 
 std::shared_ptr<section> dwarf::get_section(section_type type) const
@@ -93,16 +409,16 @@ std::shared_ptr<section> dwarf::get_section(section_type type) const
     if (type == section_type::abbrev)
         return m->sec_abbrev;
 
-    auto it = m->sections.find(type);
-    if (it != m->sections.end())
-        return it->second;
-
-    size_t size;
-    const void *data = m->l->load(type, &size);
-    if (!data)
+    size_t idx = (size_t)type;
+    std::call_once(m->sections_once[idx], [&] {
+        size_t size;
+        const void *data = m->l->load(type, &size);
+        if (data)
+            m->sections[idx] = std::make_shared<section>(section_type::str, data, size, m->sec_info->ord);
+    });
+    if (!m->sections[idx])
         throw format_error(std::string(elf::section_type_to_name(type)) + " section missing");
-    m->sections[type] = std::make_shared<section>(section_type::str, data, size, m->sec_info->ord);
-    return m->sections[type];
+    return m->sections[idx];
 }
 
 
@@ -118,10 +434,14 @@ struct unit::impl {
 
     die root, type;
     line_table lt;
+    die_tree tree;
+    std::once_flag root_once, type_once, lt_once, tree_once;
 
-    bool have_abbrevs;
-    std::vector<abbrev_entry> abbrevs_vec;
-    std::unordered_map<abbrev_code, abbrev_entry> abbrevs_map;
+    // 在 abbrevs_once 完成后才置位，使 get_abbrev 不必每次都进入 call_once
+    std::atomic<bool> have_abbrevs;
+    std::once_flag abbrevs_once;
+    // 与使用同一个缩写表的其他单元共享
+    std::shared_ptr<const abbrev_table> abbrevs;
 
     impl(const dwarf &file, section_offset offset,
          const std::shared_ptr<section> &subsec,
@@ -152,14 +472,21 @@ unit::get_section_offset() const
 
 const die & unit::root() const
 {
-    if (!m->root.valid()) {
+    std::call_once(m->root_once, [this] {
         m->force_abbrevs();
-        m->root = die(this);
-        m->root.read(m->root_offset);
-    }
+        die root(this);
+        root.read(m->root_offset);
+        m->root = root;
+    });
     return m->root;
 }
 
+const die_tree &unit::get_die_tree() const
+{
+    std::call_once(m->tree_once, [this] { m->tree = die_tree(*this); });
+    return m->tree;
+}
+
 const std::shared_ptr<section> & unit::data() const
 {
     return m->subsec;
@@ -167,50 +494,21 @@ const std::shared_ptr<section> & unit::data() const
 
 const abbrev_entry & unit::get_abbrev(abbrev_code acode) const
 {
-    if (!m->have_abbrevs)
+    if (!m->have_abbrevs.load(std::memory_order_acquire))
         m->force_abbrevs();
 
-    if (!m->abbrevs_vec.empty()) {
-        if (acode >= m->abbrevs_vec.size())
-            goto unknown;
-        const abbrev_entry &entry = m->abbrevs_vec[acode];
-        if (entry.code == 0)
-            goto unknown;
-        return entry;
-    } else {
-        auto it = m->abbrevs_map.find(acode);
-        if (it == m->abbrevs_map.end())
-            goto unknown;
-        return it->second;
-    }
-
-unknown:
-    throw format_error("unknown abbrev code 0x" + to_hex(acode));
+    const abbrev_entry *entry = m->abbrevs->find(acode);
+    if (!entry)
+        throw format_error("unknown abbrev code 0x" + to_hex(acode));
+    return *entry;
 }
 
 void unit::impl::force_abbrevs()
 {
-    if (have_abbrevs)
-        return;
-
-    cursor c(file.get_section(section_type::abbrev),
-             debug_abbrev_offset);
-    abbrev_entry entry;
-    abbrev_code highest = 0;
-    while (entry.read(&c)) {
-        abbrevs_map[entry.code] = entry;
-        if (entry.code > highest)
-            highest = entry.code;
-    }
-
-    if (highest * 10 < abbrevs_map.size() * 15) {
-        abbrevs_vec.resize(highest + 1);
-        for (auto &entry : abbrevs_map)
-            abbrevs_vec[entry.first] = move(entry.second);
-        abbrevs_map.clear();
-    }
-
-    have_abbrevs = true;
+    std::call_once(abbrevs_once, [this] {
+        abbrevs = file.get_abbrev_table(debug_abbrev_offset, *subsec);
+        have_abbrevs.store(true, std::memory_order_release);
+    });
 }
 
 compilation_unit::compilation_unit(const dwarf &file, section_offset offset)
@@ -234,28 +532,37 @@ compilation_unit::compilation_unit(const dwarf &file, section_offset offset)
 const line_table &
 compilation_unit::get_line_table() const
 {
-    if (!m->lt.valid()) {
+    // 只读取头部，行号程序在迭代或 materialize 时才解码
+    std::call_once(m->lt_once, [this] {
         const die &d = root();
         if (!d.has(DW_AT::stmt_list) || !d.has(DW_AT::name))
-            goto done;
+            return;
 
         shared_ptr<section> sec;
         try {
             sec = m->file.get_section(section_type::line);
         } catch (format_error &e) {
-            goto done;
+            return;
         }
 
         auto comp_dir = d.has(DW_AT::comp_dir) ? at_comp_dir(d) : "";
 
-        m->lt = line_table(sec, d[DW_AT::stmt_list].as_sec_offset(),
-                           m->subsec->addr_size, comp_dir,
-                           at_name(d));
-    }
-done:
+        line_table lt(sec, d[DW_AT::stmt_list].as_sec_offset(),
+                      m->subsec->addr_size, comp_dir,
+                      at_name(d));
+        m->lt = lt;
+    });
     return m->lt;
 }
 
+const line_table &
+compilation_unit::get_materialized_line_table() const
+{
+    auto &lt = get_line_table();
+    lt.materialize();
+    return lt;
+}
+
 
 type_unit::type_unit(const dwarf &file, section_offset offset)
 {
@@ -286,11 +593,12 @@ type_unit::get_type_signature() const
 const die &
 type_unit::type() const
 {
-    if (!m->type.valid()) {
+    std::call_once(m->type_once, [this] {
         m->force_abbrevs();
-        m->type = die(this);
-        m->type.read(m->type_offset);
-    }
+        die type(this);
+        type.read(m->type_offset);
+        m->type = type;
+    });
     return m->type;
 }
 
@@ -36,11 +36,7 @@ expr_result expr::evaluate(expr_context *ctx, const std::initializer_list<taddr>
     }
 
     // 为这个表达式创建一个子节，以便可以轻松地检测其结束
-    auto cusec = cu->data();
-    shared_ptr<section> subsec(make_shared<section>(cusec->type,
-                                                    cusec->begin + offset, len,
-                                                    cusec->ord, cusec->fmt,
-                                                    cusec->addr_size));
+    section_view subsec = section_view(*cu->data()).slice(offset, len);
     cursor cur(subsec);
 
     // 准备表达式结果。一些位置描述可以直接创建结果，而不是使用堆栈的栈顶元素
@@ -199,22 +195,22 @@ expr_result expr::evaluate(expr_context *ctx, const std::initializer_list<taddr>
             stack.revat(2) = tmp1.u;
             break;
         case DW_OP::deref:
-            tmp1.u = subsec->addr_size;
+            tmp1.u = subsec.addr_size;
             goto deref_common;
         case DW_OP::deref_size:
             tmp1.u = cur.fixed<uint8_t>();
-            if (tmp1.u > subsec->addr_size)
+            if (tmp1.u > subsec.addr_size)
                 throw expr_error("DW_OP_deref_size operand exceeds address size");
         deref_common:
             CHECK();
             stack.back() = ctx->deref_size(stack.back(), tmp1.u);
             break;
         case DW_OP::xderef:
-            tmp1.u = subsec->addr_size;
+            tmp1.u = subsec.addr_size;
             goto xderef_common;
         case DW_OP::xderef_size:
             tmp1.u = cur.fixed<uint8_t>();
-            if (tmp1.u > subsec->addr_size)
+            if (tmp1.u > subsec.addr_size)
                 throw expr_error("DW_OP_xderef_size operand exceeds address size");
         xderef_common:
             CHECKN(2);
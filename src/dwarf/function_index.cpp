@@ -0,0 +1,281 @@
+#include "dwarf/internal.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace dwarf
+{
+
+struct function_index::impl {
+    // 索引中的一个函数
+    struct entry {
+        section_offset offset;
+        uint32_t cu;
+    };
+
+    // 一个限定名，其函数保存在 entries[first, first + count) 中
+    struct group {
+        uint32_t name;
+        uint32_t first, count;
+    };
+
+    // 限定名的一个后缀，从第 start 个字符开始。start 为0时是完整的限定名
+    struct suffix {
+        uint32_t group;
+        uint32_t start;
+        uint32_t hash;
+    };
+
+    const vector<compilation_unit> *units;
+    flat_array<char> strings;
+    flat_array<group> groups;
+    flat_array<entry> entries;
+    flat_array<suffix> suffixes;
+    // suffixes 的开放寻址哈希表
+    flat_array<uint32_t> slots;
+    // 从索引缓存加载时保持映射的内存有效
+    shared_ptr<const void> mapping;
+
+    /**
+     * @brief 将与 name 相同的后缀对应的函数加入 out
+     *
+     * @param whole 只匹配完整的限定名
+     */
+    void find(const string &name, bool whole, vector<die> *out) const;
+    // 将 groups[i] 中的函数加入 out
+    void get(uint32_t i, vector<die> *out) const;
+};
+
+// 构建过程中的一个函数。name 是 names 中限定名的偏移量，
+// 各级名字的起始位置保存在 starts[first_start, first_start + nstarts) 中
+struct function_ref {
+    uint32_t name;
+    uint32_t first_start, nstarts;
+    uint32_t cu;
+    section_offset offset;
+};
+
+// 从一个编译单元中收集的函数
+struct index_builder::function_part {
+    vector<char> names;
+    vector<uint32_t> starts;
+    vector<function_ref> refs;
+};
+
+namespace
+{
+/**
+ * @brief 找到 d 的声明：内联函数的具体实例通过 DW_AT_abstract_origin 引用抽象实例，
+ * 在类外定义的成员函数通过 DW_AT_specification 引用类中的声明
+ *
+ */
+die find_declaration(const die &d)
+{
+    die decl = d;
+    if (decl.has(DW_AT::abstract_origin))
+        decl = decl[DW_AT::abstract_origin].as_reference();
+    if (decl.has(DW_AT::specification))
+        decl = decl[DW_AT::specification].as_reference();
+    return decl;
+}
+} // namespace
+
+shared_ptr<index_builder::function_part> index_builder::collect_functions(const dwarf &dw,
+                                                                          uint32_t cu)
+{
+    auto part = make_shared<function_part>();
+    const compilation_unit &unit = dw.compilation_units()[cu];
+    auto &tree = unit.get_die_tree();
+    vector<string> scopes;
+    string qualified;
+    for (auto ref : tree) {
+        if (ref.tag() != DW_TAG::subprogram ||
+            !(ref.has(DW_AT::low_pc) || ref.has(DW_AT::ranges)))
+            continue;
+        die d = ref.get();
+        die decl = find_declaration(d);
+        string name;
+        if (decl.has(DW_AT::name))
+            name = at_name(decl);
+        else if (d.has(DW_AT::name))
+            name = at_name(d);
+        else
+            continue;
+
+        // 声明在其他单元中或作用域无法命名时只使用函数名
+        scopes.clear();
+        if (&decl.get_unit() == &unit && !scope_names(tree.find(decl.get_unit_offset()), &scopes))
+            scopes.clear();
+        scopes.push_back(move(name));
+
+        function_ref fr{(uint32_t)part->names.size(), (uint32_t)part->starts.size(),
+                        (uint32_t)scopes.size(), cu, d.get_unit_offset()};
+        qualified.clear();
+        for (auto &scope : scopes) {
+            if (!qualified.empty())
+                qualified += "::";
+            part->starts.push_back(qualified.size());
+            qualified += scope;
+        }
+        part->names.insert(part->names.end(), qualified.begin(), qualified.end());
+        part->names.push_back('\0');
+        part->refs.push_back(fr);
+    }
+    return part;
+}
+
+function_index::function_index(const dwarf &dw)
+{
+    vector<shared_ptr<index_builder::function_part>> parts(dw.compilation_units().size());
+    parallel_for(parts.size(), 0, [&](size_t i) {
+        parts[i] = index_builder::collect_functions(dw, i);
+    });
+    *this = index_builder::merge_functions(dw, parts);
+}
+
+function_index index_builder::merge_functions(const dwarf &dw,
+                                              const vector<shared_ptr<function_part>> &parts)
+{
+    function_index idx;
+    auto m = idx.m = make_shared<function_index::impl>();
+    m->units = &dw.compilation_units();
+
+    struct named_ref {
+        const char *name;
+        const uint32_t *starts;
+        const function_ref *ref;
+    };
+    vector<named_ref> refs;
+    for (auto &part : parts)
+        for (auto &ref : part->refs)
+            refs.push_back({&part->names[ref.name], &part->starts[ref.first_start], &ref});
+
+    // 按名字排序，使同名的函数连续存放
+    sort(refs.begin(), refs.end(), [](const named_ref &a, const named_ref &b) {
+        int cmp = strcmp(a.name, b.name);
+        if (cmp != 0)
+            return cmp < 0;
+        if (a.ref->cu != b.ref->cu)
+            return a.ref->cu < b.ref->cu;
+        return a.ref->offset < b.ref->offset;
+    });
+
+    auto &strings = m->strings.owned;
+    auto &groups = m->groups.owned;
+    auto &entries = m->entries.owned;
+    auto &suffixes = m->suffixes.owned;
+    entries.reserve(refs.size());
+    for (auto &ref : refs) {
+        if (groups.empty() || strcmp(ref.name, &strings[groups.back().name]) != 0) {
+            size_t len = strlen(ref.name);
+            uint32_t group = groups.size();
+            groups.push_back({(uint32_t)strings.size(), (uint32_t)entries.size(), 0});
+            strings.insert(strings.end(), ref.name, ref.name + len + 1);
+            for (uint32_t i = 0; i < ref.ref->nstarts; i++) {
+                uint32_t start = ref.starts[i];
+                suffixes.push_back({group, start, hash_bytes(ref.name + start, len - start)});
+            }
+        }
+        groups.back().count++;
+        entries.push_back({ref.ref->offset, ref.ref->cu});
+    }
+
+    m->slots.owned = build_slots(suffixes.size(), [&](size_t i) { return suffixes[i].hash; });
+    m->strings.own();
+    m->groups.own();
+    m->entries.own();
+    m->suffixes.own();
+    m->slots.own();
+    return idx;
+}
+
+void function_index::impl::find(const string &name, bool whole, vector<die> *out) const
+{
+    uint32_t h = hash_bytes(name.data(), name.size());
+    probe_slots(slots, h, [&](uint32_t i) {
+        const suffix &s = suffixes[i];
+        if (s.hash != h || (whole && s.start != 0))
+            return true;
+        const group &g = groups[s.group];
+        if (strcmp(&strings[g.name + s.start], name.c_str()) != 0)
+            return true;
+        get(s.group, out);
+        // 不同的限定名可能有相同的后缀，继续查找
+        return true;
+    });
+}
+
+void function_index::impl::get(uint32_t i, vector<die> *out) const
+{
+    const group &g = groups[i];
+    for (uint32_t j = 0; j < g.count; j++) {
+        const entry &e = entries[g.first + j];
+        out->push_back(read_die(&(*units)[e.cu], e.offset));
+    }
+}
+
+vector<die> function_index::find(const string &name) const
+{
+    vector<die> result;
+    if (m)
+        m->find(name, true, &result);
+    return result;
+}
+
+vector<die> function_index::find_suffix(const string &name) const
+{
+    vector<die> result;
+    if (m)
+        m->find(name, false, &result);
+    return result;
+}
+
+size_t function_index::size() const
+{
+    return m ? m->groups.size : 0;
+}
+
+const char *function_index::get_name(size_t i) const
+{
+    return &m->strings[m->groups[i].name];
+}
+
+vector<die> function_index::get_functions(size_t i) const
+{
+    vector<die> result;
+    m->get(i, &result);
+    return result;
+}
+
+void index_cache::write(const function_index &idx, index_writer *w)
+{
+    w->array(idx.m->strings);
+    w->array(idx.m->groups);
+    w->array(idx.m->entries);
+    w->array(idx.m->suffixes);
+    w->array(idx.m->slots);
+}
+
+bool index_cache::read(function_index *idx, const dwarf &dw, index_reader *r)
+{
+    auto m = make_shared<function_index::impl>();
+    m->units = &dw.compilation_units();
+    m->mapping = r->mapping;
+    if (!r->array(&m->strings) || !r->array(&m->groups) || !r->array(&m->entries) ||
+        !r->array(&m->suffixes) || !r->array(&m->slots))
+        return false;
+    if (!check_strings(m->strings) || !check_slots(m->slots, m->suffixes.size))
+        return false;
+    for (auto &g : m->groups)
+        if (g.name >= m->strings.size || !check_range(g.first, g.count, m->entries.size))
+            return false;
+    for (auto &e : m->entries)
+        if (e.cu >= m->units->size())
+            return false;
+    for (auto &s : m->suffixes)
+        if (s.group >= m->groups.size || s.start >= m->strings.size - m->groups[s.group].name)
+            return false;
+    idx->m = m;
+    return true;
+}
+
+} // namespace dwarf
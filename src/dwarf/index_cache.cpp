@@ -0,0 +1,91 @@
+#include "dwarf/internal.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+namespace dwarf
+{
+
+static const char cache_magic[8] = {'M', 'D', 'B', 'G', 'I', 'D', 'X', '\0'};
+// 任何索引的内存布局改变时都要增加版本号
+static const uint64_t cache_version = 7;
+// 用于检查文件是否由相同字节序的机器写入
+static const uint64_t cache_order = 0x0102030405060708;
+
+void index_cache::header(const string &key, const dwarf &dw, index_writer *w)
+{
+    w->bytes(cache_magic, sizeof(cache_magic));
+    w->u64(cache_version);
+    w->u64(cache_order);
+    w->u64(key.size());
+    w->bytes(key.data(), key.size());
+    w->u64(dw.get_section(section_type::info)->size());
+    w->u64(dw.compilation_units().size());
+}
+
+bool index_cache::open(const string &path, const string &key,
+                       const dwarf &dw, index_reader *out)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void *base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    index_reader r;
+    r.pos = (const char *)base;
+    r.end = r.pos + size;
+    r.mapping = shared_ptr<const void>(base, [size](const void *p) { munmap((void *)p, size); });
+
+    const char *magic, *file_key;
+    uint64_t version, order, key_size, info_size, units;
+    if (!r.bytes(&magic, sizeof(cache_magic)) ||
+        memcmp(magic, cache_magic, sizeof(cache_magic)) != 0 ||
+        !r.u64(&version) || version != cache_version ||
+        !r.u64(&order) || order != cache_order ||
+        !r.u64(&key_size) || key_size != key.size() ||
+        !r.bytes(&file_key, key_size) || memcmp(file_key, key.data(), key_size) != 0 ||
+        !r.u64(&info_size) || info_size != dw.get_section(section_type::info)->size() ||
+        !r.u64(&units) || units != dw.compilation_units().size())
+        return false;
+
+    *out = r;
+    return true;
+}
+
+bool index_cache::commit(const index_writer &w, const string &path)
+{
+    string tmp = path + ".tmp" + std::to_string(getpid());
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    const char *p = w.buf.data();
+    size_t left = w.buf.size();
+    while (left) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0) {
+            close(fd);
+            unlink(tmp.c_str());
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    if (close(fd) < 0 || rename(tmp.c_str(), path.c_str()) < 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace dwarf
@@ -1,5 +1,9 @@
 #include "dwarf/internal.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <deque>
+#include <mutex>
 using namespace std;
 
 namespace dwarf
@@ -31,17 +35,80 @@ struct line_table::impl {
     ubyte opcode_base;
     vector<ubyte> standard_opcode_lengths;
     vector<string> include_directories;
+    // 头部中的文件名，构造后不再修改
     vector<file> file_names;
+    // 行号程序中 DW_LNE_define_file 定义的文件，编号接在 file_names 之后。
+    // 多个线程上的惰性迭代可能同时追加，由 defined_files_lock 保护；
+    // deque 在末尾追加时不移动已有元素，已经返回的指针保持有效
+    deque<file> defined_files;
+    std::mutex defined_files_lock;
 
     // 表示上一次读取文件名条目后，在节中的偏移量。
     // 这个变量用于追踪已读取文件名的位置，以避免重复添加相同的文件名条目
     section_offset last_file_name_end;
     // 表示文件名是否已经完整地读取
-    bool file_names_complete;
-
-    impl() : last_file_name_end(0), file_names_complete(false){};
+    std::atomic<bool> file_names_complete;
+
+    /**
+     * @brief 解码后的行号表，每一列保存所有行的一个字段
+     *
+     */
+    struct rows {
+        enum flag : ubyte {
+            is_stmt = 1 << 0,
+            basic_block = 1 << 1,
+            end_sequence = 1 << 2,
+            prologue_end = 1 << 3,
+            epilogue_begin = 1 << 4,
+        };
+
+        vector<taddr> address;
+        // 该行之后的行号程序偏移量，用于从该行继续惰性迭代
+        vector<uint32_t> pos;
+        vector<uint32_t> file_index;
+        vector<uint32_t> line;
+        vector<uint32_t> column;
+        vector<uint32_t> discriminator;
+        vector<uint32_t> isa;
+        vector<ubyte> op_index;
+        vector<ubyte> flags;
+
+        size_t size() const
+        {
+            return address.size();
+        }
+    };
+
+    /**
+     * @brief 一个序列，[low, high) 内的地址由第 first 行到第 last 行描述，
+     * 第 last 行是该序列的 end_sequence 行
+     *
+     */
+    struct sequence {
+        taddr low, high;
+        uint32_t first, last;
+        // 按 low 排序后，该序列及其之前所有序列中最大的 high
+        taddr max_high;
+    };
+
+    // 在 rows_once 完成后才置位，之后 decoded 和 sequences 不再修改
+    std::atomic<bool> have_rows;
+    std::once_flag rows_once;
+    rows decoded;
+    // 按起始地址排序的序列
+    vector<sequence> sequences;
+
+    impl() : last_file_name_end(0), file_names_complete(false), have_rows(false){};
 
     bool read_file_entry(cursor *cur, bool in_header);
+    /**
+     * @brief 返回编号为 index 的文件，还没有读到该文件的定义时返回 nullptr
+     *
+     */
+    const file *find_file(unsigned index);
+    // 已经读到的文件数量
+    size_t file_count();
+    void decode_rows(const line_table *table);
 };
 
 line_table::line_table(const shared_ptr<section> &sec, section_offset offset,
@@ -134,6 +201,8 @@ line_table::iterator line_table::begin() const
 {
     if (!valid())
         return iterator(nullptr, 0);
+    if (m->have_rows.load(std::memory_order_acquire) && m->decoded.size())
+        return iterator::at_row(this, 0);
     return iterator(this, m->program_offset);
 }
 
@@ -146,6 +215,23 @@ line_table::iterator line_table::end() const
 
 line_table::iterator line_table::find_address(taddr addr) const
 {
+    if (materialized()) {
+        auto &seqs = m->sequences;
+        auto &addrs = m->decoded.address;
+        auto it = upper_bound(seqs.begin(), seqs.end(), addr,
+                              [](taddr addr, const impl::sequence &s) { return addr < s.low; });
+        // 序列之间可能重叠，向前检查直到之前的序列都不可能包含 addr
+        while (it != seqs.begin() && (it - 1)->max_high > addr) {
+            --it;
+            if (addr >= it->high)
+                continue;
+            auto row = upper_bound(addrs.begin() + it->first,
+                                   addrs.begin() + it->last, addr);
+            return iterator::at_row(this, row - addrs.begin() - 1);
+        }
+        return end();
+    }
+
     iterator prev = begin(), e = end();
     if (prev == e)
         return prev;
@@ -160,26 +246,99 @@ line_table::iterator line_table::find_address(taddr addr) const
     return prev;
 }
 
+void line_table::materialize() const
+{
+    if (!valid() || m->have_rows.load(std::memory_order_acquire))
+        return;
+    std::call_once(m->rows_once, [this] { m->decode_rows(this); });
+}
+
+void line_table::impl::decode_rows(const line_table *table)
+{
+    if (program_offset < sec->size()) {
+        // 直接驱动迭代器执行行号程序，这样最后一行也会被记录下来
+        iterator it(table, program_offset);
+        while (true) {
+            const entry &e = it.entry;
+            decoded.address.push_back(e.address);
+            decoded.pos.push_back(it.pos);
+            decoded.file_index.push_back(e.file_index);
+            decoded.line.push_back(e.line);
+            decoded.column.push_back(e.column);
+            decoded.discriminator.push_back(e.discriminator);
+            decoded.isa.push_back(e.isa);
+            decoded.op_index.push_back(e.op_index);
+            decoded.flags.push_back((e.is_stmt ? rows::is_stmt : 0) |
+                                    (e.basic_block ? rows::basic_block : 0) |
+                                    (e.end_sequence ? rows::end_sequence : 0) |
+                                    (e.prologue_end ? rows::prologue_end : 0) |
+                                    (e.epilogue_begin ? rows::epilogue_begin : 0));
+            if (it.pos >= sec->size())
+                break;
+            ++it;
+        }
+    }
+    file_names_complete = true;
+
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < decoded.size(); i++) {
+        if (!(decoded.flags[i] & rows::end_sequence))
+            continue;
+        if (i > first)
+            sequences.push_back({decoded.address[first], decoded.address[i], first, i, 0});
+        first = i + 1;
+    }
+    sort(sequences.begin(), sequences.end(),
+         [](const sequence &a, const sequence &b) { return a.low < b.low; });
+    taddr max_high = 0;
+    for (auto &seq : sequences)
+        seq.max_high = max_high = max(max_high, seq.high);
+
+    have_rows.store(true, std::memory_order_release);
+}
+
+bool line_table::materialized() const
+{
+    return valid() && m->have_rows.load(std::memory_order_acquire);
+}
+
 const line_table::file * line_table::get_file(unsigned index) const
 {
-    if (index >= m->file_names.size()) {
+    const file *f = m->find_file(index);
+    if (!f) {
         // 如果索引超出了范围，代码将尝试在行号表的程序中查找是否存在该文件的声明。
         // 然而，这样的情况可能很罕见
         if (!m->file_names_complete) {
             for (auto &ent : *this)
                 (void)ent;
+            f = m->find_file(index);
         }
-        if (index >= m->file_names.size())
+        if (!f)
             throw out_of_range("file name index " + std::to_string(index) +
                                " exceeds file table size of " +
-                               std::to_string(m->file_names.size()));
+                               std::to_string(m->file_count()));
     }
-    return &m->file_names[index];
+    return f;
+}
+
+const line_table::file *line_table::impl::find_file(unsigned index)
+{
+    if (index < file_names.size())
+        return &file_names[index];
+    index -= file_names.size();
+    std::lock_guard<std::mutex> guard(defined_files_lock);
+    return index < defined_files.size() ? &defined_files[index] : nullptr;
+}
+
+size_t line_table::impl::file_count()
+{
+    std::lock_guard<std::mutex> guard(defined_files_lock);
+    return file_names.size() + defined_files.size();
 }
 
 bool line_table::impl::read_file_entry(cursor *cur, bool in_header)
 {
-    assert(cur->sec == sec);
+    assert(cur->sec.begin == sec->begin);
 
     string file_name;
     cur->string(file_name);
@@ -189,21 +348,28 @@ bool line_table::impl::read_file_entry(cursor *cur, bool in_header)
     uint64_t mtime = cur->uleb128();
     uint64_t length = cur->uleb128();
 
-    // 已经处理过
-    if (cur->get_section_offset() <= last_file_name_end)
-        return true;
-    last_file_name_end = cur->get_section_offset();
-
+    string path;
     if (file_name[0] == '/')
-        file_names.emplace_back(move(file_name), mtime, length);
+        path = move(file_name);
     else if (dir_index < include_directories.size())
-        file_names.emplace_back(
-            include_directories[dir_index] + file_name,
-            mtime, length);
+        path = include_directories[dir_index] + file_name;
     else
         throw format_error("file name directory index out of range: " +
                            std::to_string(dir_index));
 
+    // 头部只在构造函数中读取，不需要加锁
+    if (in_header) {
+        file_names.emplace_back(move(path), mtime, length);
+        last_file_name_end = cur->get_section_offset();
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(defined_files_lock);
+    // 已经处理过
+    if (cur->get_section_offset() <= last_file_name_end)
+        return true;
+    last_file_name_end = cur->get_section_offset();
+    defined_files.emplace_back(move(path), mtime, length);
     return true;
 }
 
@@ -235,7 +401,7 @@ string line_table::entry::get_description() const
 }
 
 line_table::iterator::iterator(const line_table *table, section_offset pos)
-    : table(table), pos(pos)
+    : table(table), pos(pos), row(~(uint32_t)0)
 {
     if (table) {
         regs.reset(table->m->default_is_stmt);
@@ -243,8 +409,59 @@ line_table::iterator::iterator(const line_table *table, section_offset pos)
     }
 }
 
+line_table::iterator line_table::iterator::at_row(const line_table *table, uint32_t row)
+{
+    iterator it;
+    it.table = table;
+    it.load_row(row);
+    return it;
+}
+
+void line_table::iterator::load_row(uint32_t row)
+{
+    struct line_table::impl *m = table->m.get();
+    const impl::rows &rows = m->decoded;
+
+    this->row = row;
+    pos = rows.pos[row];
+    entry.address = rows.address[row];
+    entry.op_index = rows.op_index[row];
+    entry.file_index = rows.file_index[row];
+    // 解码时已经检查过文件编号
+    entry.file = m->find_file(entry.file_index);
+    entry.line = rows.line[row];
+    entry.column = rows.column[row];
+    entry.is_stmt = rows.flags[row] & impl::rows::is_stmt;
+    entry.basic_block = rows.flags[row] & impl::rows::basic_block;
+    entry.end_sequence = rows.flags[row] & impl::rows::end_sequence;
+    entry.prologue_end = rows.flags[row] & impl::rows::prologue_end;
+    entry.epilogue_begin = rows.flags[row] & impl::rows::epilogue_begin;
+    entry.isa = rows.isa[row];
+    entry.discriminator = rows.discriminator[row];
+
+    // 恢复输出该行之后状态机寄存器的值，使迭代器可以继续惰性执行
+    if (entry.end_sequence) {
+        regs.reset(m->default_is_stmt);
+    } else {
+        regs = entry;
+        regs.file = nullptr;
+        regs.basic_block = regs.prologue_end = regs.epilogue_begin = false;
+        regs.discriminator = 0;
+    }
+}
+
 line_table::iterator & line_table::iterator::operator++()
 {
+    if (row != ~(uint32_t)0) {
+        if (row + 1 < table->m->decoded.size()) {
+            load_row(row + 1);
+        } else {
+            row = ~(uint32_t)0;
+            pos = table->m->sec->size();
+        }
+        return *this;
+    }
+
     cursor cur(table->m->sec, pos);
 
     // 执行指令直到达到流的结尾或者某个指令生成了一个行号表
@@ -261,9 +478,8 @@ line_table::iterator & line_table::iterator::operator++()
     }
     if (output) {
         // 解析相应的文件名
-        if (entry.file_index < table->m->file_names.size())
-            entry.file = &table->m->file_names[entry.file_index];
-        else
+        entry.file = table->m->find_file(entry.file_index);
+        if (!entry.file)
             throw format_error("bad file index " +
                                std::to_string(entry.file_index) +
                                " in line table");
@@ -0,0 +1,295 @@
+#include "dwarf/internal.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace dwarf
+{
+
+struct line_index::impl {
+    // 一个驻留的文件路径，下标即文件编号
+    struct path {
+        // 路径在 strings 中的偏移量，以NUL结尾
+        uint32_t name;
+        // 文件名（路径的最后一部分）的哈希值
+        uint32_t base_hash;
+    };
+
+    // 文件 file 第 line 行的地址保存在 addrs[first, first + count) 中
+    struct location {
+        uint32_t file, line;
+        uint32_t first, count;
+    };
+
+    flat_array<char> strings;
+    flat_array<path> paths;
+    // 按文件名查找 paths 的开放寻址哈希表，用于按后缀查找
+    flat_array<uint32_t> path_slots;
+    flat_array<location> lines;
+    // 按 (文件编号, 行号) 查找 lines 的开放寻址哈希表
+    flat_array<uint32_t> line_slots;
+    flat_array<taddr> addrs;
+    // 从索引缓存加载时保持映射的内存有效
+    shared_ptr<const void> mapping;
+
+    static uint32_t line_hash(uint32_t file, uint32_t line)
+    {
+        uint32_t key[2] = {file, line};
+        return hash_bytes((const char *)key, sizeof(key));
+    }
+
+    static const char *basename(const char *path, size_t len, size_t *len_out)
+    {
+        const char *p = path + len;
+        while (p > path && p[-1] != '/')
+            p--;
+        *len_out = path + len - p;
+        return p;
+    }
+
+    /**
+     * @brief 驻留文件路径，返回其文件编号
+     *
+     * @param ids 构建过程中路径到文件编号的映射
+     * @param path
+     */
+    uint32_t intern(unordered_map<string, uint32_t> *ids, const string &path)
+    {
+        auto it = ids->find(path);
+        if (it != ids->end())
+            return it->second;
+        uint32_t id = paths.owned.size();
+        size_t base_len;
+        const char *base = basename(path.data(), path.size(), &base_len);
+        uint32_t name = strings.owned.size();
+        paths.owned.push_back({name, hash_bytes(base, base_len)});
+        strings.owned.insert(strings.owned.end(), path.c_str(), path.c_str() + path.size() + 1);
+        ids->emplace(path, id);
+        return id;
+    }
+
+    /**
+     * @brief 判断 path 是否以 file 的若干个完整部分结尾
+     *
+     * @param path
+     * @param file
+     */
+    static bool matches(const char *path, const string &file)
+    {
+        size_t len = strlen(path);
+        if (file.size() > len)
+            return false;
+        size_t diff = len - file.size();
+        if (file.compare(0, string::npos, path + diff) != 0)
+            return false;
+        return diff == 0 || path[diff - 1] == '/' || file[0] == '/';
+    }
+};
+
+namespace
+{
+// 构建过程中的一行
+struct line_row {
+    uint32_t file, line;
+    // 包含该行的函数 DIE 在 .debug_info 中的偏移量，
+    // 不在任何函数中时为序列编号并设置最高位
+    uint64_t group;
+    taddr addr;
+};
+
+const uint64_t no_function = (uint64_t)1 << 63;
+} // namespace
+
+// 一个编译单元的行，file 为 paths 的下标，不在函数中的行的 group 为单元内的序列编号
+struct index_builder::line_part {
+    vector<string> paths;
+    vector<line_row> rows;
+    uint64_t sequences = 0;
+};
+
+shared_ptr<index_builder::line_part>
+index_builder::collect_lines(const dwarf &dw, const pc_index &pcs, uint32_t cu)
+{
+    auto part = make_shared<line_part>();
+    const line_table &lt = dw.compilation_units()[cu].get_materialized_line_table();
+    if (!lt.valid())
+        return part;
+
+    // 行号表中的文件下标到 paths 下标的映射
+    vector<uint32_t> ids;
+    uint64_t &seq = part->sequences;
+    for (auto &e : lt) {
+        if (e.end_sequence) {
+            seq++;
+            continue;
+        }
+        if (!e.is_stmt || e.line == 0)
+            continue;
+        if (e.file_index >= ids.size())
+            ids.resize(e.file_index + 1, ~(uint32_t)0);
+        if (ids[e.file_index] == ~(uint32_t)0) {
+            ids[e.file_index] = part->paths.size();
+            part->paths.push_back(lt.get_file(e.file_index)->path);
+        }
+
+        section_offset func;
+        uint64_t group = pcs.find_offset(e.address, &func) ? func : (no_function | seq);
+        part->rows.push_back({ids[e.file_index], e.line, group, e.address});
+    }
+    seq++;
+    return part;
+}
+
+line_index::line_index(const dwarf &dw)
+{
+    const pc_index &pcs = dw.get_pc_index();
+    vector<shared_ptr<index_builder::line_part>> parts(dw.compilation_units().size());
+    parallel_for(parts.size(), 0, [&](size_t i) {
+        parts[i] = index_builder::collect_lines(dw, pcs, i);
+    });
+    *this = index_builder::merge_lines(dw, parts);
+}
+
+line_index index_builder::merge_lines(const dwarf &, const vector<shared_ptr<line_part>> &parts)
+{
+    line_index idx;
+    auto m = idx.m = make_shared<line_index::impl>();
+
+    // 按编译单元的顺序驻留路径，并把单元内的序列编号换成全局的编号
+    unordered_map<string, uint32_t> path_ids;
+    vector<line_row> rows;
+    uint64_t seq = 0;
+    for (auto &part : parts) {
+        vector<uint32_t> ids;
+        for (auto &path : part->paths)
+            ids.push_back(m->intern(&path_ids, path));
+        for (auto row : part->rows) {
+            row.file = ids[row.file];
+            if (row.group & no_function)
+                row.group += seq;
+            rows.push_back(row);
+        }
+        seq += part->sequences;
+    }
+
+    // 同一函数中的同一行只保留最低的地址
+    sort(rows.begin(), rows.end(), [](const line_row &a, const line_row &b) {
+        if (a.file != b.file)
+            return a.file < b.file;
+        if (a.line != b.line)
+            return a.line < b.line;
+        if (a.group != b.group)
+            return a.group < b.group;
+        return a.addr < b.addr;
+    });
+    rows.erase(unique(rows.begin(), rows.end(), [](const line_row &a, const line_row &b) {
+                   return a.file == b.file && a.line == b.line && a.group == b.group;
+               }),
+               rows.end());
+    sort(rows.begin(), rows.end(), [](const line_row &a, const line_row &b) {
+        if (a.file != b.file)
+            return a.file < b.file;
+        if (a.line != b.line)
+            return a.line < b.line;
+        return a.addr < b.addr;
+    });
+
+    auto &lines = m->lines.owned;
+    auto &addrs = m->addrs.owned;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (!lines.empty() && lines.back().file == rows[i].file &&
+            lines.back().line == rows[i].line) {
+            if (addrs.back() != rows[i].addr) {
+                addrs.push_back(rows[i].addr);
+                lines.back().count++;
+            }
+            continue;
+        }
+        lines.push_back({rows[i].file, rows[i].line, (uint32_t)addrs.size(), 1});
+        addrs.push_back(rows[i].addr);
+    }
+
+    auto &paths = m->paths.owned;
+    m->path_slots.owned = build_slots(paths.size(), [&](size_t i) { return paths[i].base_hash; });
+    m->line_slots.owned = build_slots(lines.size(), [&](size_t i) {
+        return line_index::impl::line_hash(lines[i].file, lines[i].line);
+    });
+    m->strings.own();
+    m->paths.own();
+    m->path_slots.own();
+    m->lines.own();
+    m->line_slots.own();
+    m->addrs.own();
+    return idx;
+}
+
+vector<taddr> line_index::find(const string &file, unsigned line) const
+{
+    vector<taddr> result;
+    if (!m || file.empty())
+        return result;
+
+    size_t base_len;
+    const char *base = impl::basename(file.data(), file.size(), &base_len);
+    uint32_t base_hash = hash_bytes(base, base_len);
+    probe_slots(m->path_slots, base_hash, [&](uint32_t id) {
+        const impl::path &p = m->paths[id];
+        if (p.base_hash != base_hash || !impl::matches(&m->strings[p.name], file))
+            return true;
+        uint32_t h = impl::line_hash(id, line);
+        probe_slots(m->line_slots, h, [&](uint32_t i) {
+            const impl::location &loc = m->lines[i];
+            if (loc.file != id || loc.line != line)
+                return true;
+            result.insert(result.end(), m->addrs.begin() + loc.first,
+                          m->addrs.begin() + loc.first + loc.count);
+            return false;
+        });
+        return true;
+    });
+    sort(result.begin(), result.end());
+    result.erase(unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+size_t line_index::files() const
+{
+    return m ? m->paths.size : 0;
+}
+
+size_t line_index::size() const
+{
+    return m ? m->addrs.size : 0;
+}
+
+void index_cache::write(const line_index &idx, index_writer *w)
+{
+    w->array(idx.m->strings);
+    w->array(idx.m->paths);
+    w->array(idx.m->path_slots);
+    w->array(idx.m->lines);
+    w->array(idx.m->line_slots);
+    w->array(idx.m->addrs);
+}
+
+bool index_cache::read(line_index *idx, const dwarf &, index_reader *r)
+{
+    auto m = make_shared<line_index::impl>();
+    m->mapping = r->mapping;
+    if (!r->array(&m->strings) || !r->array(&m->paths) ||
+        !r->array(&m->path_slots) || !r->array(&m->lines) ||
+        !r->array(&m->line_slots) || !r->array(&m->addrs))
+        return false;
+    if (!check_strings(m->strings) || !check_slots(m->path_slots, m->paths.size) ||
+        !check_slots(m->line_slots, m->lines.size))
+        return false;
+    for (auto &p : m->paths)
+        if (p.name >= m->strings.size)
+            return false;
+    for (auto &loc : m->lines)
+        if (loc.file >= m->paths.size || !check_range(loc.first, loc.count, m->addrs.size))
+            return false;
+    idx->m = m;
+    return true;
+}
+
+} // namespace dwarf
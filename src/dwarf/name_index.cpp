@@ -0,0 +1,311 @@
+#include "dwarf/internal.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace dwarf
+{
+
+// 构建过程中的一个名字。name 指向节数据中的字符串，与 dwarf 对象的生命周期相同
+struct name_ref {
+    const char *name;
+    // 编译单元在 dwarf::compilation_units() 中的下标
+    uint32_t cu;
+    // DIE 相对于其编译单元的偏移量
+    section_offset offset;
+};
+
+struct name_index::impl {
+    // 索引中的一个 DIE
+    struct entry {
+        section_offset offset;
+        uint32_t cu;
+    };
+
+    // 一个名字，其 DIE 保存在 entries[first, first + count) 中
+    struct group {
+        // 名字在 strings 中的偏移量，以NUL结尾
+        uint32_t name;
+        uint32_t hash;
+        uint32_t first, count;
+    };
+
+    const vector<compilation_unit> *units;
+    flat_array<char> strings;
+    flat_array<group> groups;
+    // groups 的开放寻址哈希表
+    flat_array<uint32_t> slots;
+    flat_array<entry> entries;
+    // 从索引缓存加载时保持映射的内存有效
+    shared_ptr<const void> mapping;
+};
+
+namespace
+{
+/**
+ * @brief 根据 .debug_info 中的偏移量查找编译单元的下标
+ *
+ */
+bool find_unit(const vector<compilation_unit> &units, section_offset off, uint32_t *out)
+{
+    auto it = lower_bound(units.begin(), units.end(), off,
+                          [](const compilation_unit &cu, section_offset off) {
+                              return cu.get_section_offset() < off;
+                          });
+    if (it == units.end() || it->get_section_offset() != off)
+        return false;
+    *out = it - units.begin();
+    return true;
+}
+
+/**
+ * @brief 读取 .debug_pubnames 或 .debug_pubtypes 节 (DWARF4 section 6.1.1)
+ *
+ * @param units
+ * @param sec
+ * @param covered 不为空时记录出现在节中的编译单元
+ * @param refs 收集到的名字
+ */
+void read_names(const vector<compilation_unit> &units, const shared_ptr<section> &sec,
+                vector<bool> *covered, vector<name_ref> *refs)
+{
+    cursor cur(sec);
+    while (!cur.end()) {
+        name_unit nu;
+        nu.read(&cur);
+        uint32_t cu;
+        if (!find_unit(units, nu.debug_info_offset, &cu))
+            continue;
+        if (covered)
+            (*covered)[cu] = true;
+        while (!nu.entries.end()) {
+            // 偏移量为0的条目结束该单元
+            section_offset off = nu.entries.offset();
+            if (off == 0)
+                break;
+            refs->push_back({nu.entries.cstr(), cu, off});
+        }
+    }
+}
+
+/**
+ * @brief 判断 tag 类型的 DIE 是否加入名字索引
+ *
+ */
+bool is_named_tag(DW_TAG tag)
+{
+    switch (tag) {
+    case DW_TAG::subprogram:
+    case DW_TAG::variable:
+    case DW_TAG::base_type:
+    case DW_TAG::class_type:
+    case DW_TAG::structure_type:
+    case DW_TAG::union_type:
+    case DW_TAG::enumeration_type:
+    case DW_TAG::typedef_:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 判断在 tag 类型的 DIE 下是否可能嵌套有全局名字
+ *
+ */
+bool may_contain_names(DW_TAG tag)
+{
+    switch (tag) {
+    case DW_TAG::namespace_:
+    case DW_TAG::module:
+    case DW_TAG::class_type:
+    case DW_TAG::structure_type:
+    case DW_TAG::union_type:
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct scanner {
+    vector<name_ref> *refs;
+    uint32_t cu;
+    bool skip_external;
+
+    void add(const value &v, const die &d)
+    {
+        if (v.get_type() == value::type::string)
+            refs->push_back({v.as_cstr(), cu, d.get_unit_offset()});
+    }
+
+    void walk(const die &d)
+    {
+        for (auto &child : d) {
+            if (is_named_tag(child.tag) &&
+                !(skip_external && child.has(DW_AT::external) && at_external(child))) {
+                if (child.has(DW_AT::specification) || child.has(DW_AT::abstract_origin)) {
+                    add(child.resolve(DW_AT::name), child);
+                    add(child.resolve(DW_AT::linkage_name), child);
+                } else {
+                    if (child.has(DW_AT::name))
+                        add(child[DW_AT::name], child);
+                    if (child.has(DW_AT::linkage_name))
+                        add(child[DW_AT::linkage_name], child);
+                }
+            }
+            if (may_contain_names(child.tag))
+                walk(child);
+        }
+    }
+};
+} // namespace
+
+// 从一个编译单元或 pubnames 中收集的名字
+struct index_builder::name_part {
+    vector<name_ref> refs;
+};
+
+shared_ptr<index_builder::name_part>
+index_builder::collect_pubnames(const dwarf &dw, vector<bool> *covered)
+{
+    auto part = make_shared<name_part>();
+    auto &units = dw.compilation_units();
+    covered->assign(units.size(), false);
+
+    shared_ptr<section> pubnames, pubtypes;
+    try {
+        pubnames = dw.get_section(section_type::pubnames);
+        pubtypes = dw.get_section(section_type::pubtypes);
+    } catch (format_error &e) {
+    }
+    if (pubnames) {
+        read_names(units, pubnames, covered, &part->refs);
+        if (pubtypes)
+            read_names(units, pubtypes, nullptr, &part->refs);
+    }
+    return part;
+}
+
+shared_ptr<index_builder::name_part> index_builder::collect_names(const dwarf &dw, uint32_t cu,
+                                                                  bool skip_external)
+{
+    auto part = make_shared<name_part>();
+    scanner s{&part->refs, cu, skip_external};
+    s.walk(dw.compilation_units()[cu].root());
+    return part;
+}
+
+name_index::name_index(const dwarf &dw)
+{
+    vector<bool> covered;
+    vector<shared_ptr<index_builder::name_part>> parts(dw.compilation_units().size() + 1);
+    parts[0] = index_builder::collect_pubnames(dw, &covered);
+    // pubnames 只列出外部名字，其中的单元仍需扫描静态函数、静态变量和类型等
+    parallel_for(covered.size(), 0, [&](size_t i) {
+        parts[i + 1] = index_builder::collect_names(dw, i, covered[i]);
+    });
+    *this = index_builder::merge_names(dw, parts);
+}
+
+name_index index_builder::merge_names(const dwarf &dw, const vector<shared_ptr<name_part>> &parts)
+{
+    name_index idx;
+    auto m = idx.m = make_shared<name_index::impl>();
+    m->units = &dw.compilation_units();
+
+    vector<name_ref> refs;
+    for (auto &part : parts)
+        refs.insert(refs.end(), part->refs.begin(), part->refs.end());
+
+    // 按名字排序并去掉重复的 DIE，使同名的 DIE 连续存放
+    sort(refs.begin(), refs.end(), [](const name_ref &a, const name_ref &b) {
+        int cmp = strcmp(a.name, b.name);
+        if (cmp != 0)
+            return cmp < 0;
+        if (a.cu != b.cu)
+            return a.cu < b.cu;
+        return a.offset < b.offset;
+    });
+    refs.erase(unique(refs.begin(), refs.end(), [](const name_ref &a, const name_ref &b) {
+                   return a.cu == b.cu && a.offset == b.offset && strcmp(a.name, b.name) == 0;
+               }),
+               refs.end());
+
+    // 每个名字只保存一次，与其 DIE 一起组成连续的数组
+    auto &strings = m->strings.owned;
+    auto &groups = m->groups.owned;
+    auto &entries = m->entries.owned;
+    entries.reserve(refs.size());
+    for (auto &ref : refs) {
+        if (groups.empty() || strcmp(ref.name, &strings[groups.back().name]) != 0) {
+            size_t len = strlen(ref.name);
+            groups.push_back({(uint32_t)strings.size(), hash_bytes(ref.name, len),
+                              (uint32_t)entries.size(), 0});
+            strings.insert(strings.end(), ref.name, ref.name + len + 1);
+        }
+        groups.back().count++;
+        entries.push_back({ref.offset, ref.cu});
+    }
+    vector<name_ref>().swap(refs);
+
+    m->slots.owned = build_slots(groups.size(), [&](size_t i) { return groups[i].hash; });
+    m->strings.own();
+    m->groups.own();
+    m->slots.own();
+    m->entries.own();
+    return idx;
+}
+
+vector<die> name_index::find(const string &name) const
+{
+    vector<die> result;
+    if (!m)
+        return result;
+    uint32_t h = hash_bytes(name.data(), name.size());
+    probe_slots(m->slots, h, [&](uint32_t i) {
+        const impl::group &g = m->groups[i];
+        if (g.hash != h ||
+            strcmp(&m->strings[g.name], name.c_str()) != 0)
+            return true;
+        for (uint32_t j = 0; j < g.count; j++) {
+            const impl::entry &e = m->entries[g.first + j];
+            result.push_back(read_die(&(*m->units)[e.cu], e.offset));
+        }
+        return false;
+    });
+    return result;
+}
+
+size_t name_index::size() const
+{
+    return m ? m->groups.size : 0;
+}
+
+void index_cache::write(const name_index &idx, index_writer *w)
+{
+    w->array(idx.m->strings);
+    w->array(idx.m->groups);
+    w->array(idx.m->slots);
+    w->array(idx.m->entries);
+}
+
+bool index_cache::read(name_index *idx, const dwarf &dw, index_reader *r)
+{
+    auto m = make_shared<name_index::impl>();
+    m->units = &dw.compilation_units();
+    m->mapping = r->mapping;
+    if (!r->array(&m->strings) || !r->array(&m->groups) ||
+        !r->array(&m->slots) || !r->array(&m->entries))
+        return false;
+    if (!check_strings(m->strings) || !check_slots(m->slots, m->groups.size))
+        return false;
+    for (auto &g : m->groups)
+        if (g.name >= m->strings.size || !check_range(g.first, g.count, m->entries.size))
+            return false;
+    for (auto &e : m->entries)
+        if (e.cu >= m->units->size())
+            return false;
+    idx->m = m;
+    return true;
+}
+
+} // namespace dwarf
@@ -0,0 +1,134 @@
+#include "dwarf/internal.hpp"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+namespace dwarf
+{
+
+namespace
+{
+// 一个线程尚未处理的下标 [next, end)，其他线程从 end 一侧窃取
+struct work_range {
+    mutex lock;
+    size_t next, end;
+
+    size_t remaining()
+    {
+        lock_guard<mutex> guard(lock);
+        return end - next;
+    }
+};
+
+struct work_pool {
+    vector<work_range> ranges;
+    const function<void(size_t)> &fn;
+    atomic<bool> failed;
+    mutex error_lock;
+    exception_ptr error;
+
+    work_pool(size_t n, unsigned threads, const function<void(size_t)> &fn)
+        : ranges(threads), fn(fn), failed(false)
+    {
+        for (unsigned i = 0; i < threads; i++) {
+            ranges[i].next = n * i / threads;
+            ranges[i].end = n * (i + 1) / threads;
+        }
+    }
+
+    bool pop(unsigned self, size_t *out)
+    {
+        lock_guard<mutex> guard(ranges[self].lock);
+        if (ranges[self].next == ranges[self].end)
+            return false;
+        *out = ranges[self].next++;
+        return true;
+    }
+
+    /**
+     * @brief 从剩余下标最多的线程末尾窃取一半放入自己的范围
+     *
+     * @return false 所有线程都没有剩余的下标
+     */
+    bool steal(unsigned self)
+    {
+        while (true) {
+            unsigned victim = self;
+            size_t most = 0;
+            for (unsigned i = 0; i < ranges.size(); i++) {
+                if (i == self)
+                    continue;
+                size_t left = ranges[i].remaining();
+                if (left > most) {
+                    most = left;
+                    victim = i;
+                }
+            }
+            if (victim == self)
+                return false;
+
+            size_t lo, hi;
+            {
+                lock_guard<mutex> guard(ranges[victim].lock);
+                size_t left = ranges[victim].end - ranges[victim].next;
+                // 在查看和加锁之间被其他线程取走了，重新选择
+                if (left == 0)
+                    continue;
+                hi = ranges[victim].end;
+                lo = hi - (left + 1) / 2;
+                ranges[victim].end = lo;
+            }
+            lock_guard<mutex> guard(ranges[self].lock);
+            ranges[self].next = lo;
+            ranges[self].end = hi;
+            return true;
+        }
+    }
+
+    void run(unsigned self)
+    {
+        size_t i;
+        while (!failed.load(memory_order_relaxed)) {
+            if (!pop(self, &i) && !(steal(self) && pop(self, &i)))
+                return;
+            try {
+                fn(i);
+            } catch (...) {
+                lock_guard<mutex> guard(error_lock);
+                if (!error)
+                    error = current_exception();
+                failed = true;
+            }
+        }
+    }
+};
+} // namespace
+
+void parallel_for(size_t n, unsigned parallelism, const function<void(size_t)> &fn)
+{
+    if (parallelism == 0)
+        parallelism = max(1u, thread::hardware_concurrency());
+    if (parallelism > n)
+        parallelism = n;
+    if (parallelism <= 1) {
+        for (size_t i = 0; i < n; i++)
+            fn(i);
+        return;
+    }
+
+    work_pool pool(n, parallelism, fn);
+    vector<thread> threads;
+    threads.reserve(parallelism - 1);
+    for (unsigned i = 1; i < parallelism; i++)
+        threads.emplace_back([&pool, i] { pool.run(i); });
+    // 当前线程也作为一个工作线程
+    pool.run(0);
+    for (auto &t : threads)
+        t.join();
+    if (pool.error)
+        rethrow_exception(pool.error);
+}
+
+} // namespace dwarf
@@ -0,0 +1,291 @@
+#include "dwarf/internal.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace dwarf
+{
+
+// 表示区间不属于任何函数
+static const uint32_t no_entry = ~(uint32_t)0;
+
+// 索引中的一个函数 DIE
+struct pc_entry {
+    // DIE 相对于其编译单元的偏移量
+    section_offset offset;
+    // 编译单元在 dwarf::compilation_units() 中的下标
+    uint32_t cu;
+    // 包含该函数的外层函数的下标，没有则为 no_entry
+    uint32_t parent;
+};
+
+struct pc_index::impl {
+    typedef pc_entry entry;
+
+    // 从 low 开始直到下一个区间的 low 为止的地址都属于 entry
+    struct segment {
+        taddr low;
+        uint32_t entry;
+    };
+
+    const vector<compilation_unit> *units;
+    flat_array<entry> entries;
+    flat_array<segment> segments;
+    // 从索引缓存加载时保持映射的内存有效
+    shared_ptr<const void> mapping;
+
+    /**
+     * @brief 二分查找包含 pc 的区间，返回其函数的下标
+     *
+     * @param pc
+     * @return uint32_t 没有函数包含 pc 时返回 no_entry
+     */
+    uint32_t lookup(taddr pc) const
+    {
+        auto it = upper_bound(segments.begin(), segments.end(), pc,
+                              [](taddr pc, const segment &s) { return pc < s.low; });
+        if (it == segments.begin())
+            return no_entry;
+        return (it - 1)->entry;
+    }
+
+    die get_die(uint32_t idx) const
+    {
+        const entry &e = entries[idx];
+        return read_die(&(*units)[e.cu], e.offset);
+    }
+};
+
+namespace
+{
+// 构建过程中函数 DIE 的一个地址范围
+struct interval {
+    taddr low, high;
+    unsigned depth;
+    uint32_t entry;
+};
+
+/**
+ * @brief 判断在 tag 类型的 DIE 下是否可能嵌套有函数 DIE，
+ * 用于跳过变量、类型等不相关的子树
+ *
+ */
+bool may_contain_functions(DW_TAG tag)
+{
+    switch (tag) {
+    case DW_TAG::compile_unit:
+    case DW_TAG::partial_unit:
+    case DW_TAG::module:
+    case DW_TAG::namespace_:
+    case DW_TAG::subprogram:
+    case DW_TAG::inlined_subroutine:
+    case DW_TAG::lexical_block:
+    case DW_TAG::class_type:
+    case DW_TAG::structure_type:
+    case DW_TAG::union_type:
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct builder {
+    vector<pc_entry> *entries;
+    vector<interval> *intervals;
+
+    void add_ranges(const die &d, uint32_t idx, unsigned depth)
+    {
+        // 属性格式错误的函数没有地址范围，不影响其他函数
+        size_t n = intervals->size();
+        try {
+            add_ranges_or_throw(d, idx, depth);
+        } catch (format_error &) {
+            intervals->resize(n);
+        } catch (out_of_range &) {
+            intervals->resize(n);
+        }
+    }
+
+    void add_ranges_or_throw(const die &d, uint32_t idx, unsigned depth)
+    {
+        // 范围表已经去掉空范围并合并了重叠的范围，之后 die_pc_contains 直接使用缓存的表
+        if (d.has(DW_AT::ranges)) {
+            for (auto &r : die_range_table(d)->ranges)
+                intervals->push_back({r.first, r.second, depth, idx});
+            return;
+        }
+        taddr low = at_low_pc(d);
+        taddr high = d.has(DW_AT::high_pc) ? at_high_pc(d) : (low + 1);
+        if (low < high)
+            intervals->push_back({low, high, depth, idx});
+    }
+
+    void walk(const die &d, uint32_t cu, uint32_t parent, unsigned depth)
+    {
+        for (auto &child : d) {
+            uint32_t next_parent = parent;
+            if ((child.tag == DW_TAG::subprogram ||
+                 child.tag == DW_TAG::inlined_subroutine) &&
+                (child.has(DW_AT::low_pc) || child.has(DW_AT::ranges))) {
+                next_parent = entries->size();
+                entries->push_back({child.get_unit_offset(), cu, parent});
+                add_ranges(child, next_parent, depth);
+            }
+            if (may_contain_functions(child.tag))
+                walk(child, cu, next_parent, depth + 1);
+        }
+    }
+};
+} // namespace
+
+// 一个编译单元中的函数，下标从0开始，合并时再加上之前各单元的函数数量
+struct index_builder::pc_part {
+    vector<pc_entry> entries;
+    vector<interval> intervals;
+};
+
+shared_ptr<index_builder::pc_part> index_builder::collect_pcs(const dwarf &dw, uint32_t cu)
+{
+    auto part = make_shared<pc_part>();
+    builder b{&part->entries, &part->intervals};
+    b.walk(dw.compilation_units()[cu].root(), cu, no_entry, 0);
+    return part;
+}
+
+pc_index index_builder::merge_pcs(const dwarf &dw, const vector<shared_ptr<pc_part>> &parts)
+{
+    pc_index idx;
+    auto m = idx.m = make_shared<pc_index::impl>();
+    m->units = &dw.compilation_units();
+
+    auto &entries = m->entries.owned;
+    vector<interval> ivs;
+    for (auto &part : parts) {
+        uint32_t base = entries.size();
+        for (auto e : part->entries) {
+            if (e.parent != no_entry)
+                e.parent += base;
+            entries.push_back(e);
+        }
+        for (auto iv : part->intervals) {
+            iv.entry += base;
+            ivs.push_back(iv);
+        }
+    }
+
+    // 按起始地址排序，起始地址相同时外层（更长、更浅）的区间在前
+    sort(ivs.begin(), ivs.end(), [](const interval &a, const interval &b) {
+        if (a.low != b.low)
+            return a.low < b.low;
+        if (a.high != b.high)
+            return a.high > b.high;
+        return a.depth < b.depth;
+    });
+
+    // 扫描线：栈顶始终是覆盖当前地址的最内层函数，
+    // 每当栈顶发生变化时输出一个新的区间
+    auto emit = [&m](taddr low, uint32_t idx) {
+        auto &segs = m->segments.owned;
+        if (!segs.empty() && segs.back().low == low) {
+            segs.back().entry = idx;
+            if (segs.size() > 1 && segs[segs.size() - 2].entry == idx)
+                segs.pop_back();
+        } else if (segs.empty() || segs.back().entry != idx) {
+            segs.push_back({low, idx});
+        }
+    };
+    vector<const interval *> stack;
+    auto pop_until = [&](taddr addr) {
+        while (!stack.empty() && stack.back()->high <= addr) {
+            taddr end = stack.back()->high;
+            stack.pop_back();
+            // 被外层区间完全包含的区间已经结束，恢复外层函数
+            while (!stack.empty() && stack.back()->high <= end)
+                stack.pop_back();
+            emit(end, stack.empty() ? no_entry : stack.back()->entry);
+        }
+    };
+    for (auto &iv : ivs) {
+        pop_until(iv.low);
+        emit(iv.low, iv.entry);
+        stack.push_back(&iv);
+    }
+    pop_until(~(taddr)0);
+    m->segments.own();
+    m->entries.own();
+    return idx;
+}
+
+pc_index::pc_index(const dwarf &dw)
+{
+    vector<shared_ptr<index_builder::pc_part>> parts(dw.compilation_units().size());
+    parallel_for(parts.size(), 0, [&](size_t i) { parts[i] = index_builder::collect_pcs(dw, i); });
+    *this = index_builder::merge_pcs(dw, parts);
+}
+
+die pc_index::find(taddr pc) const
+{
+    if (!m)
+        return die();
+    uint32_t idx = m->lookup(pc);
+    if (idx == no_entry)
+        return die();
+    return m->get_die(idx);
+}
+
+vector<die> pc_index::find_stack(taddr pc) const
+{
+    vector<die> stack;
+    if (!m)
+        return stack;
+    for (uint32_t idx = m->lookup(pc); idx != no_entry; idx = m->entries[idx].parent)
+        stack.push_back(m->get_die(idx));
+    return stack;
+}
+
+bool pc_index::find_offset(taddr pc, section_offset *out) const
+{
+    if (!m)
+        return false;
+    uint32_t idx = m->lookup(pc);
+    if (idx == no_entry)
+        return false;
+    const impl::entry &e = m->entries[idx];
+    *out = (*m->units)[e.cu].get_section_offset() + e.offset;
+    return true;
+}
+
+size_t pc_index::size() const
+{
+    return m ? m->entries.size : 0;
+}
+
+void index_cache::write(const pc_index &idx, index_writer *w)
+{
+    w->array(idx.m->entries);
+    w->array(idx.m->segments);
+}
+
+bool index_cache::read(pc_index *idx, const dwarf &dw, index_reader *r)
+{
+    auto m = make_shared<pc_index::impl>();
+    m->units = &dw.compilation_units();
+    m->mapping = r->mapping;
+    if (!r->array(&m->entries) || !r->array(&m->segments))
+        return false;
+    // 外层函数总在其内层函数之前，查找外层函数时不会循环
+    for (uint32_t i = 0; i < m->entries.size; i++) {
+        const pc_entry &e = m->entries[i];
+        if (e.cu >= m->units->size() || (e.parent != no_entry && e.parent >= i))
+            return false;
+    }
+    for (size_t i = 0; i < m->segments.size; i++) {
+        auto &s = m->segments[i];
+        if ((s.entry != no_entry && s.entry >= m->entries.size) ||
+            (i && s.low < m->segments[i - 1].low))
+            return false;
+    }
+    idx->m = m;
+    return true;
+}
+
+} // namespace dwarf
@@ -1,37 +1,33 @@
 #include "dwarf/internal.hpp"
+#include <algorithm>
 using namespace std;
 
 namespace dwarf
 {
 rangelist::rangelist(const std::shared_ptr<section> &sec, section_offset off,
                      unsigned cu_addr_size, taddr cu_low_pc)
-    : sec(sec->slice(off, ~0, format::unknown, cu_addr_size)),
-      base_addr(cu_low_pc)
+    : sec(sec), off(off), addr_size(cu_addr_size), base_addr(cu_low_pc)
 {
 }
 
 rangelist::rangelist(const initializer_list<pair<taddr, taddr>> &ranges)
+    : off(0), addr_size(sizeof(taddr)), base_addr(0)
 {
-    synthetic.reserve(ranges.size() * 2 + 2);
+    synthetic.reserve(ranges.size());
+    // 与 .debug_ranges 一样，{0, 0} 表示列表结束
     for (auto &range : ranges) {
-        synthetic.push_back(range.first);
-        synthetic.push_back(range.second);
+        if (range.first == 0 && range.second == 0)
+            break;
+        synthetic.push_back(range);
     }
-    synthetic.push_back(0);
-    synthetic.push_back(0);
-
-    sec = make_shared<section>(
-        section_type::ranges, (const char *)synthetic.data(),
-        synthetic.size() * sizeof(taddr),
-        native_order(), format::unknown, sizeof(taddr));
-
-    base_addr = 0;
 }
 
 rangelist::iterator rangelist::begin() const
 {
     if (sec)
-        return iterator(sec, base_addr);
+        return iterator(sec.get(), off, addr_size, base_addr);
+    if (!synthetic.empty())
+        return iterator(&synthetic[0], &synthetic[0] + synthetic.size());
     return end();
 }
 
@@ -48,28 +44,49 @@ bool rangelist::contains(taddr addr) const
     return false;
 }
 
-rangelist::iterator::iterator(const std::shared_ptr<section> &sec, taddr base_addr)
-    : sec(sec), base_addr(base_addr), pos(0)
+rangelist::iterator::iterator(const section *sec, section_offset off,
+                              unsigned addr_size, taddr base_addr)
+    : sec(sec), synth(nullptr), synth_end(nullptr),
+      addr_size(addr_size), base_addr(base_addr), pos(off)
+{
+    ++(*this);
+}
+
+rangelist::iterator::iterator(const pair<taddr, taddr> *begin, const pair<taddr, taddr> *end)
+    : sec(nullptr), synth(begin), synth_end(end), addr_size(0), base_addr(0), pos(0)
 {
     ++(*this);
 }
 
 rangelist::iterator & rangelist::iterator::operator++()
 {
+    if (synth) {
+        if (synth == synth_end) {
+            synth = synth_end = nullptr;
+        } else {
+            entry.low = synth->first;
+            entry.high = synth->second;
+            synth++;
+        }
+        return *this;
+    }
+
 
     // 初始化为无符号整数的最大值
     taddr largest_offset = ~(taddr)0;
-    if (sec->addr_size < sizeof(taddr))
-        largest_offset += 1 << (8 * sec->addr_size);
+    if (addr_size < sizeof(taddr))
+        largest_offset += 1 << (8 * addr_size);
 
-    cursor cur(sec, pos);
+    section_view view(*sec);
+    view.addr_size = addr_size;
+    cursor cur(view, pos);
     while (true) {
         entry.low = cur.address();
         entry.high = cur.address();
 
         if (entry.low == 0 && entry.high == 0) {
             // 表示到达了范围列表的结尾
-            sec.reset();
+            sec = nullptr;
             pos = 0;
             break;
         } else if (entry.low == largest_offset) {
@@ -87,4 +104,31 @@ rangelist::iterator & rangelist::iterator::operator++()
     return *this;
 }
 
-} // namespace dwarf
\ No newline at end of file
+range_table::range_table(const rangelist &rl)
+{
+    for (auto &r : rl)
+        if (r.low < r.high)
+            ranges.push_back({r.low, r.high});
+    sort(ranges.begin(), ranges.end());
+
+    // 合并重叠和相邻的范围，使每个地址最多落在一个范围中
+    size_t out = 0;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (out && ranges[i].first <= ranges[out - 1].second)
+            ranges[out - 1].second = max(ranges[out - 1].second, ranges[i].second);
+        else
+            ranges[out++] = ranges[i];
+    }
+    ranges.resize(out);
+    ranges.shrink_to_fit();
+}
+
+bool range_table::contains(taddr addr) const
+{
+    // 第一个起始地址大于addr的范围之前的那个范围
+    auto it = upper_bound(ranges.begin(), ranges.end(), addr,
+                          [](taddr a, const pair<taddr, taddr> &r) { return a < r.first; });
+    return it != ranges.begin() && addr < (it - 1)->second;
+}
+
+} // namespace dwarf
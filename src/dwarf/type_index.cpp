@@ -0,0 +1,387 @@
+#include "dwarf/internal.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace dwarf
+{
+
+struct type_index::impl {
+    // 索引中的一个 DIE
+    struct entry {
+        section_offset offset;
+        // 小于编译单元数量时为编译单元的下标，否则为 signatures 的下标加上编译单元数量
+        uint32_t unit;
+        // 见 decl_flag
+        uint32_t flags;
+    };
+
+    // 一个限定名，其 DIE 保存在 entries[first, first + count) 中，定义在前
+    struct group {
+        uint32_t name;
+        uint32_t hash;
+        uint32_t first, count;
+    };
+
+    static const uint32_t decl_flag = 1;
+
+    const vector<compilation_unit> *units;
+    flat_array<char> strings;
+    flat_array<group> groups;
+    // groups 的开放寻址哈希表
+    flat_array<uint32_t> slots;
+    flat_array<entry> entries;
+    // 出现在索引中的类型单元的签名
+    flat_array<uint64_t> signatures;
+    // 从索引缓存加载时保持映射的内存有效
+    shared_ptr<const void> mapping;
+
+    const group *find(const string &name) const;
+    die get(const entry &e) const;
+};
+
+// 构建过程中的一个类型。name 是 names 中限定名的偏移量
+struct type_ref {
+    uint32_t name;
+    uint32_t unit;
+    section_offset offset;
+    DW_TAG tag;
+    bool decl;
+    uint64_t size;
+};
+
+// 从一个单元中收集的类型
+struct index_builder::type_part {
+    vector<char> names;
+    vector<type_ref> refs;
+    // 类型单元的签名，编译单元为0
+    uint64_t signature;
+};
+
+namespace
+{
+/**
+ * @brief 判断 tag 类型的 DIE 是否加入类型名索引
+ *
+ */
+bool is_type_tag(DW_TAG tag)
+{
+    switch (tag) {
+    case DW_TAG::base_type:
+    case DW_TAG::class_type:
+    case DW_TAG::structure_type:
+    case DW_TAG::union_type:
+    case DW_TAG::enumeration_type:
+    case DW_TAG::typedef_:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 判断 tag 类型的 DIE 是否是可以嵌套类型的作用域
+ *
+ */
+bool is_scope_tag(DW_TAG tag)
+{
+    switch (tag) {
+    case DW_TAG::namespace_:
+    case DW_TAG::class_type:
+    case DW_TAG::structure_type:
+    case DW_TAG::union_type:
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct type_scanner {
+    index_builder::type_part *part;
+    uint32_t unit;
+    const die_tree &tree;
+
+    void add(const die &d, const string &name)
+    {
+        type_ref ref{(uint32_t)part->names.size(), unit, d.get_unit_offset(), d.tag, false, 0};
+        ref.decl = d.has(DW_AT::declaration) && at_declaration(d);
+        if (d.has(DW_AT::byte_size)) {
+            value v = d[DW_AT::byte_size];
+            if (v.get_type() == value::type::constant || v.get_type() == value::type::uconstant)
+                ref.size = v.as_uconstant();
+        }
+        part->names.insert(part->names.end(), name.begin(), name.end());
+        part->names.push_back('\0');
+        part->refs.push_back(ref);
+    }
+
+    /**
+     * @brief 返回 ref 的限定名，用于通过 DW_AT_specification 引用声明的定义
+     *
+     */
+    bool qualified_name(die_ref ref, string *out)
+    {
+        vector<string> parts;
+        string name;
+        if (!ref.valid() || !scope_names(ref, &parts) || !scope_name(ref.get(), &name))
+            return false;
+        parts.push_back(move(name));
+        out->clear();
+        for (auto &part : parts) {
+            if (!out->empty())
+                *out += "::";
+            *out += part;
+        }
+        return true;
+    }
+
+    void walk(die_ref parent, string &prefix)
+    {
+        for (auto ref = parent.first_child(); ref.valid(); ref = ref.next_sibling()) {
+            DW_TAG tag = ref.tag();
+            if (!is_type_tag(tag) && !is_scope_tag(tag))
+                continue;
+            die d = ref.get();
+            string saved, name;
+            if (d.has(DW_AT::specification)) {
+                // 在外层作用域之外定义的类型（类型单元中常见），限定名由声明的位置决定
+                value spec = d[DW_AT::specification];
+                if (spec.get_form() == DW_FORM::ref_addr ||
+                    !qualified_name(tree.find(spec.as_reference().get_unit_offset()), &name))
+                    continue;
+                saved.swap(prefix);
+                prefix = name;
+            } else if (scope_name(d, &name)) {
+                saved = prefix;
+                if (!prefix.empty())
+                    prefix += "::";
+                prefix += name;
+            } else {
+                // 匿名类型中嵌套的类型无法通过名字引用
+                continue;
+            }
+            if (is_type_tag(tag))
+                add(d, prefix);
+            if (is_scope_tag(tag))
+                walk(ref, prefix);
+            prefix.swap(saved);
+        }
+    }
+};
+} // namespace
+
+bool scope_name(const die &d, string *out)
+{
+    if (d.has(DW_AT::name)) {
+        *out = at_name(d);
+        return true;
+    }
+    if (d.tag == DW_TAG::namespace_) {
+        *out = "(anonymous namespace)";
+        return true;
+    }
+    return false;
+}
+
+bool scope_names(die_ref ref, vector<string> *out)
+{
+    out->clear();
+    for (ref = ref.parent(); ref.valid() && is_scope_tag(ref.tag()); ref = ref.parent()) {
+        string name;
+        if (!scope_name(ref.get(), &name))
+            return false;
+        out->push_back(move(name));
+    }
+    reverse(out->begin(), out->end());
+    return true;
+}
+
+shared_ptr<index_builder::type_part> index_builder::collect_types(const dwarf &dw, uint32_t unit)
+{
+    auto part = make_shared<type_part>();
+    auto &cus = dw.compilation_units();
+    const struct unit *u;
+    if (unit < cus.size()) {
+        u = &cus[unit];
+        part->signature = 0;
+    } else {
+        auto &tu = dw.get_type_unit_at(unit - cus.size());
+        u = &tu;
+        part->signature = tu.get_type_signature();
+    }
+    auto &tree = u->get_die_tree();
+    if (!tree.size())
+        return part;
+    type_scanner s{part.get(), unit, tree};
+    string prefix;
+    s.walk(tree.at(0), prefix);
+    return part;
+}
+
+type_index::type_index(const dwarf &dw)
+{
+    size_t units = dw.compilation_units().size() + dw.type_unit_count();
+    vector<shared_ptr<index_builder::type_part>> parts(units);
+    parallel_for(units, 0, [&](size_t i) { parts[i] = index_builder::collect_types(dw, i); });
+    *this = index_builder::merge_types(dw, parts);
+}
+
+type_index index_builder::merge_types(const dwarf &dw, const vector<shared_ptr<type_part>> &parts)
+{
+    type_index idx;
+    auto m = idx.m = make_shared<type_index::impl>();
+    m->units = &dw.compilation_units();
+    uint32_t cus = m->units->size();
+
+    struct named_ref {
+        const char *name;
+        const type_ref *ref;
+    };
+    vector<named_ref> refs;
+    for (auto &part : parts)
+        for (auto &ref : part->refs)
+            refs.push_back({&part->names[ref.name], &ref});
+
+    // 按名字排序，同名的定义在声明之前，再按单元的顺序
+    sort(refs.begin(), refs.end(), [](const named_ref &a, const named_ref &b) {
+        int cmp = strcmp(a.name, b.name);
+        if (cmp != 0)
+            return cmp < 0;
+        if (a.ref->decl != b.ref->decl)
+            return b.ref->decl;
+        if (a.ref->unit != b.ref->unit)
+            return a.ref->unit < b.ref->unit;
+        return a.ref->offset < b.ref->offset;
+    });
+
+    // 类型单元的下标改为其签名在 signatures 中的下标
+    vector<uint32_t> tu_slot(parts.size(), ~0u);
+    auto &signatures = m->signatures.owned;
+    auto &strings = m->strings.owned;
+    auto &groups = m->groups.owned;
+    auto &entries = m->entries.owned;
+    for (size_t i = 0; i < refs.size();) {
+        size_t end = i;
+        while (end < refs.size() && strcmp(refs[end].name, refs[i].name) == 0)
+            end++;
+
+        size_t len = strlen(refs[i].name);
+        groups.push_back({(uint32_t)strings.size(), hash_bytes(refs[i].name, len),
+                          (uint32_t)entries.size(), 0});
+        strings.insert(strings.end(), refs[i].name, refs[i].name + len + 1);
+        for (size_t j = i; j < end; j++) {
+            const type_ref &ref = *refs[j].ref;
+            // 有定义时丢弃声明，只有声明时保留第一个
+            if (j > i && (ref.decl || refs[i].ref->decl))
+                break;
+            // 标签和大小都相同的定义视为同一个类型的多份拷贝
+            bool dup = false;
+            for (size_t k = i; k < j && !dup; k++)
+                dup = refs[k].ref->tag == ref.tag && refs[k].ref->size == ref.size;
+            if (dup)
+                continue;
+
+            uint32_t unit = ref.unit;
+            if (unit >= cus) {
+                uint32_t &slot = tu_slot[unit];
+                if (slot == ~0u) {
+                    slot = signatures.size();
+                    signatures.push_back(parts[unit]->signature);
+                }
+                unit = cus + slot;
+            }
+            entries.push_back({ref.offset, unit, ref.decl ? type_index::impl::decl_flag : 0});
+            groups.back().count++;
+        }
+        i = end;
+    }
+
+    m->slots.owned = build_slots(groups.size(), [&](size_t i) { return groups[i].hash; });
+    m->strings.own();
+    m->groups.own();
+    m->slots.own();
+    m->entries.own();
+    m->signatures.own();
+    return idx;
+}
+
+const type_index::impl::group *type_index::impl::find(const string &name) const
+{
+    const group *result = nullptr;
+    uint32_t h = hash_bytes(name.data(), name.size());
+    probe_slots(slots, h, [&](uint32_t i) {
+        const group &g = groups[i];
+        if (g.hash != h || strcmp(&strings[g.name], name.c_str()) != 0)
+            return true;
+        result = &g;
+        return false;
+    });
+    return result;
+}
+
+die type_index::impl::get(const entry &e) const
+{
+    if (e.unit < units->size())
+        return read_die(&(*units)[e.unit], e.offset);
+    // 有类型单元时一定有编译单元引用它们
+    uint64_t sig = signatures[e.unit - units->size()];
+    return read_die(&units->front().get_dwarf().get_type_unit(sig), e.offset);
+}
+
+die type_index::find(const string &name) const
+{
+    if (!m)
+        return die();
+    const impl::group *g = m->find(name);
+    if (!g)
+        return die();
+    return m->get(m->entries[g->first]);
+}
+
+vector<die> type_index::find_all(const string &name) const
+{
+    vector<die> result;
+    if (!m)
+        return result;
+    const impl::group *g = m->find(name);
+    if (!g)
+        return result;
+    for (uint32_t i = 0; i < g->count; i++)
+        result.push_back(m->get(m->entries[g->first + i]));
+    return result;
+}
+
+size_t type_index::size() const
+{
+    return m ? m->groups.size : 0;
+}
+
+void index_cache::write(const type_index &idx, index_writer *w)
+{
+    w->array(idx.m->strings);
+    w->array(idx.m->groups);
+    w->array(idx.m->slots);
+    w->array(idx.m->entries);
+    w->array(idx.m->signatures);
+}
+
+bool index_cache::read(type_index *idx, const dwarf &dw, index_reader *r)
+{
+    auto m = make_shared<type_index::impl>();
+    m->units = &dw.compilation_units();
+    m->mapping = r->mapping;
+    if (!r->array(&m->strings) || !r->array(&m->groups) ||
+        !r->array(&m->slots) || !r->array(&m->entries) || !r->array(&m->signatures))
+        return false;
+    if (!check_strings(m->strings) || !check_slots(m->slots, m->groups.size))
+        return false;
+    for (auto &g : m->groups)
+        if (g.name >= m->strings.size || !check_range(g.first, g.count, m->entries.size))
+            return false;
+    for (auto &e : m->entries)
+        if (e.unit >= m->units->size() + m->signatures.size)
+            return false;
+    idx->m = m;
+    return true;
+}
+
+} // namespace dwarf
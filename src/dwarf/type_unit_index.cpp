@@ -0,0 +1,58 @@
+#include "dwarf/internal.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace dwarf
+{
+
+type_unit_index::type_unit_index(const dwarf &dw)
+{
+    cursor cur(dw.get_section(section_type::types));
+    while (!cur.end()) {
+        section_offset offset = cur.get_section_offset();
+        // 类型单元的头部 (DWARF4 section 7.5.1.2)，只读取到类型签名为止
+        cursor sub(cur.subview());
+        sub.skip_initial_length();
+        uhalf version = sub.fixed<uhalf>();
+        if (version != 4)
+            throw format_error("unknown type unit version " + std::to_string(version));
+        sub.offset();
+        sub.fixed<ubyte>();
+        entries.owned.push_back({sub.fixed<uint64_t>(), offset});
+    }
+    // 签名相同时保留偏移量最小的单元
+    stable_sort(entries.owned.begin(), entries.owned.end(),
+                [](const entry &a, const entry &b) { return a.signature < b.signature; });
+    entries.own();
+}
+
+bool type_unit_index::find(uint64_t signature, size_t *out) const
+{
+    auto it = lower_bound(entries.begin(), entries.end(), signature,
+                          [](const entry &e, uint64_t sig) { return e.signature < sig; });
+    if (it == entries.end() || it->signature != signature)
+        return false;
+    *out = it - entries.begin();
+    return true;
+}
+
+void index_cache::write(const type_unit_index &idx, index_writer *w)
+{
+    w->array(idx.entries);
+}
+
+bool index_cache::read(type_unit_index *idx, index_reader *r)
+{
+    type_unit_index result;
+    result.mapping = r->mapping;
+    if (!r->array(&result.entries))
+        return false;
+    // find 二分查找签名
+    for (size_t i = 1; i < result.entries.size; i++)
+        if (result.entries[i].signature < result.entries[i - 1].signature)
+            return false;
+    *idx = result;
+    return true;
+}
+
+} // namespace dwarf
@@ -176,19 +176,9 @@ die value::as_reference() const
         off = cur.uleb128();
         break;
 
-    case DW_FORM::ref_addr: {
-        off = cur.offset();
-        // 通过gcc生成ref_addr 较少，不建缓存
-        const compilation_unit *base_cu = nullptr;
-        for (auto &file_cu : cu->get_dwarf().compilation_units()) {
-            if (file_cu.get_section_offset() > off)
-                break;
-            base_cu = &file_cu;
-        }
-        die d(base_cu);
-        d.read(off - base_cu->get_section_offset());
-        return d;
-    }
+    case DW_FORM::ref_addr:
+        // LTO 和 dwz 生成的文件中大量使用 ref_addr，由 dwarf 查找并缓存
+        return cu->get_dwarf().resolve_ref_addr(cur.offset());
 
     case DW_FORM::ref_sig8: {
         uint64_t sig = cur.fixed<uint64_t>();
@@ -1,6 +1,7 @@
 #include "elf/elf.hpp"
 #include <cstring>
 #include <elf.h>
+#include <mutex>
 
 using namespace std;
 
@@ -58,6 +59,10 @@ struct elf::impl {
 
     section invalid_section; // 表示无效的节
     segment invalid_segment; // 表示无效的段
+
+    symbol_index syms; // 按需构建的符号索引
+    symbolizer addrs;  // 按需构建的地址到符号的查找表
+    once_flag syms_once, addrs_once;
 };
 
 
@@ -160,6 +165,58 @@ elf::get_section(unsigned index) const
     return sections().at(index);
 }
 
+std::string
+elf::get_build_id() const
+{
+    // NT_GNU_BUILD_ID 类型的注释，名字为"GNU"
+    const Elf64::Word nt_gnu_build_id = 3;
+    byte_order ord = m->hdr.ei_data == elfdata::lsb ? byte_order::lsb : byte_order::msb;
+    auto word = [ord](const char *p) {
+        Elf64::Word v;
+        memcpy(&v, p, sizeof(v));
+        return swizzle(v, ord, byte_order::native);
+    };
+
+    for (auto &sec : sections()) {
+        if (sec.get_hdr().type != sht::note || !sec.data())
+            continue;
+        const char *p = (const char *)sec.data(), *end = p + sec.size();
+        // 每个注释由 namesz、descsz、type 以及按4字节对齐的名字和描述组成
+        while (end - p >= 12) {
+            Elf64::Word namesz = word(p), descsz = word(p + 4), type = word(p + 8);
+            const char *name = p + 12;
+            const char *desc = name + ((namesz + 3) & ~3);
+            if (desc > end || (size_t)(end - desc) < descsz)
+                break;
+            if (type == nt_gnu_build_id && namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+                static const char hex[] = "0123456789abcdef";
+                std::string out;
+                for (Elf64::Word i = 0; i < descsz; i++) {
+                    out += hex[(unsigned char)desc[i] >> 4];
+                    out += hex[(unsigned char)desc[i] & 0xf];
+                }
+                return out;
+            }
+            p = desc + ((descsz + 3) & ~3);
+        }
+    }
+    return "";
+}
+
+const symbol_index &
+elf::get_symbol_index() const
+{
+    call_once(m->syms_once, [this] { m->syms = symbol_index(*this); });
+    return m->syms;
+}
+
+const symbolizer &
+elf::get_symbolizer() const
+{
+    call_once(m->addrs_once, [this] { m->addrs = symbolizer(*this); });
+    return m->addrs;
+}
+
 const segment &
 elf::get_segment(unsigned index) const
 {
@@ -231,6 +288,8 @@ struct section::impl {
     const char *name;
     size_t name_len;
     const void *data;
+    // 名字和数据在第一次使用时加载，多个线程可以同时访问同一个节
+    once_flag name_once, data_once;
 };
 
 section::section(const elf &f, const void *hdr)
@@ -248,10 +307,11 @@ section::get_hdr() const
 const char *
 section::get_name(size_t *len_out) const
 {
-    if (!m->name)
+    call_once(m->name_once, [this] {
         m->name = m->f.get_section(m->f.get_hdr().shstrndx)
                       .as_strtab()
                       .get(m->hdr.name, &m->name_len);
+    });
     if (len_out)
         *len_out = m->name_len;
     return m->name;
@@ -268,8 +328,9 @@ section::data() const
 {
     if (m->hdr.type == sht::nobits)
         return nullptr;
-    if (!m->data)
+    call_once(m->data_once, [this] {
         m->data = m->f.get_loader()->load(m->hdr.offset, m->hdr.size);
+    });
     return m->data;
 }
 
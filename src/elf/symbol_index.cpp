@@ -0,0 +1,319 @@
+#include "elf/elf.hpp"
+#include <cstring>
+
+using namespace std;
+
+namespace elf
+{
+
+/**
+ * @brief GNU 风格的符号哈希函数，.gnu.hash 和开放寻址哈希表都使用它
+ *
+ */
+static uint32_t gnu_hash(const char *name, size_t len)
+{
+    uint32_t h = 5381;
+    for (size_t i = 0; i < len; i++)
+        h = (h << 5) + h + (unsigned char)name[i];
+    return h;
+}
+
+/**
+ * @brief System V ABI 中 .hash 节使用的哈希函数
+ *
+ */
+static uint32_t sysv_hash(const char *name, size_t len)
+{
+    uint32_t h = 0;
+    for (size_t i = 0; i < len; i++) {
+        h = (h << 4) + (unsigned char)name[i];
+        uint32_t g = h & 0xf0000000;
+        if (g)
+            h ^= g >> 24;
+        h &= ~g;
+    }
+    return h;
+}
+
+template <typename E, byte_order Order>
+static Sym<> canon_sym(const char *data)
+{
+    Sym<> out;
+    out.from(*(const Sym<E, Order> *)data);
+    return out;
+}
+
+struct symbol_index::impl {
+    // 一个符号表以及用于查找它的哈希表
+    struct table {
+        sht type;
+        const char *data;
+        size_t count;
+        strtab strs;
+
+        enum class hash_kind {
+            none,
+            gnu,
+            sysv,
+        } kind;
+
+        // .gnu.hash 或 .hash 的各个部分
+        uint32_t nbuckets, symoffset, bloom_size, bloom_shift;
+        const char *bloom, *buckets, *chain;
+        size_t nchain;
+
+        // 开放寻址哈希表，槽中保存符号下标加一，0 表示空槽。
+        // 使用 .gnu.hash 时只包含其中没有的前 symoffset 个（未定义的）符号
+        vector<uint32_t> slots;
+        // 每个符号名的 gnu_hash，用于在比较字符串之前过滤
+        vector<uint32_t> hashes;
+
+        table() : count(0), kind(hash_kind::none) {}
+    };
+
+    elfclass cls;
+    byte_order ord;
+    size_t stride;
+    table dynsym, symtab;
+
+    template <typename T>
+    T word(const char *p) const
+    {
+        T v;
+        memcpy(&v, p, sizeof(v));
+        return swizzle(v, ord, byte_order::native);
+    }
+
+    Sym<> get_sym(const table &t, size_t idx) const
+    {
+        const char *p = t.data + idx * stride;
+        if (cls == elfclass::_32)
+            return ord == byte_order::lsb ? canon_sym<Elf32, byte_order::lsb>(p)
+                                          : canon_sym<Elf32, byte_order::msb>(p);
+        return ord == byte_order::lsb ? canon_sym<Elf64, byte_order::lsb>(p)
+                                      : canon_sym<Elf64, byte_order::msb>(p);
+    }
+
+    /**
+     * @brief 如果 t 的第 idx 个符号名为 name，则写入 out（未满时）并返回 true
+     *
+     */
+    bool match(const table &t, size_t idx, const char *name, size_t len,
+               symbol_ref *out) const
+    {
+        Sym<> data = get_sym(t, idx);
+        size_t sym_len;
+        const char *sym_name;
+        try {
+            sym_name = t.strs.get(data.name, &sym_len);
+        } catch (range_error &e) {
+            return false;
+        }
+        if (sym_len != len || memcmp(sym_name, name, len) != 0)
+            return false;
+        if (out)
+            *out = symbol_ref{sym_name, sym_len, data, t.type};
+        return true;
+    }
+
+    void load(table *t, const section &sec, const elf &f)
+    {
+        t->type = sec.get_hdr().type;
+        t->data = (const char *)sec.data();
+        t->count = t->data ? sec.size() / stride : 0;
+        t->strs = f.get_section(sec.get_hdr().link).as_strtab();
+    }
+
+    /**
+     * @brief 解析 .gnu.hash 节的头部，格式不正确时返回 false
+     *
+     */
+    bool load_gnu_hash(table *t, const section &sec)
+    {
+        const char *p = (const char *)sec.data();
+        size_t size = sec.size();
+        if (!p || size < 16)
+            return false;
+        t->nbuckets = word<uint32_t>(p);
+        t->symoffset = word<uint32_t>(p + 4);
+        t->bloom_size = word<uint32_t>(p + 8);
+        t->bloom_shift = word<uint32_t>(p + 12);
+        size_t bloom_word = cls == elfclass::_32 ? 4 : 8;
+        size_t header = 16 + (size_t)t->bloom_size * bloom_word + (size_t)t->nbuckets * 4;
+        if (t->nbuckets == 0 || t->bloom_size == 0 || header > size ||
+            t->symoffset > t->count)
+            return false;
+        t->bloom = p + 16;
+        t->buckets = t->bloom + (size_t)t->bloom_size * bloom_word;
+        t->chain = t->buckets + (size_t)t->nbuckets * 4;
+        t->nchain = (size - header) / 4;
+        t->kind = table::hash_kind::gnu;
+        return true;
+    }
+
+    /**
+     * @brief 解析 .hash 节的头部，格式不正确时返回 false
+     *
+     */
+    bool load_sysv_hash(table *t, const section &sec)
+    {
+        const char *p = (const char *)sec.data();
+        size_t size = sec.size();
+        if (!p || size < 8)
+            return false;
+        t->nbuckets = word<uint32_t>(p);
+        t->nchain = word<uint32_t>(p + 4);
+        if (t->nbuckets == 0 || 8 + ((size_t)t->nbuckets + t->nchain) * 4 > size)
+            return false;
+        t->buckets = p + 8;
+        t->chain = t->buckets + (size_t)t->nbuckets * 4;
+        t->kind = table::hash_kind::sysv;
+        return true;
+    }
+
+    void build_open(table *t, size_t end)
+    {
+        size_t cap = 16;
+        while (cap < end * 2)
+            cap <<= 1;
+        t->slots.assign(cap, 0);
+        t->hashes.resize(end);
+        for (size_t i = 1; i < end; i++) {
+            size_t len;
+            const char *name;
+            try {
+                name = t->strs.get(get_sym(*t, i).name, &len);
+            } catch (range_error &e) {
+                continue;
+            }
+            if (len == 0)
+                continue;
+            uint32_t h = t->hashes[i] = gnu_hash(name, len);
+            size_t slot = h & (cap - 1);
+            while (t->slots[slot])
+                slot = (slot + 1) & (cap - 1);
+            t->slots[slot] = i + 1;
+        }
+    }
+
+    size_t lookup(const table &t, const char *name, size_t len,
+                  symbol_ref *out, size_t max) const
+    {
+        size_t found = 0;
+        auto emit = [&](size_t idx) {
+            if (idx < t.count && match(t, idx, name, len, found < max ? out + found : nullptr))
+                found++;
+        };
+
+        switch (t.kind) {
+        case table::hash_kind::none:
+            break;
+        case table::hash_kind::gnu: {
+            uint32_t h = gnu_hash(name, len);
+            // 先用布隆过滤器排除不存在的名字
+            size_t bits = cls == elfclass::_32 ? 32 : 64;
+            size_t n = (h / bits) % t.bloom_size;
+            uint64_t bword = bits == 32 ? word<uint32_t>(t.bloom + n * 4)
+                                        : word<uint64_t>(t.bloom + n * 8);
+            uint64_t mask = ((uint64_t)1 << (h % bits)) |
+                            ((uint64_t)1 << ((h >> t.bloom_shift) % bits));
+            if ((bword & mask) != mask)
+                break;
+            uint32_t idx = word<uint32_t>(t.buckets + (h % t.nbuckets) * 4);
+            if (idx < t.symoffset)
+                break;
+            for (; idx - t.symoffset < t.nchain; idx++) {
+                uint32_t h2 = word<uint32_t>(t.chain + (idx - t.symoffset) * 4);
+                if ((h | 1) == (h2 | 1))
+                    emit(idx);
+                // 最低位为1表示链结束
+                if (h2 & 1)
+                    break;
+            }
+            break;
+        }
+        case table::hash_kind::sysv: {
+            uint32_t h = sysv_hash(name, len);
+            uint32_t idx = word<uint32_t>(t.buckets + (h % t.nbuckets) * 4);
+            // 限制步数，防止损坏的链形成环
+            for (size_t steps = 0; idx != 0 && idx < t.nchain && steps < t.nchain; steps++) {
+                emit(idx);
+                idx = word<uint32_t>(t.chain + idx * 4);
+            }
+            break;
+        }
+        }
+
+        if (!t.slots.empty()) {
+            uint32_t h = gnu_hash(name, len);
+            size_t mask = t.slots.size() - 1;
+            for (size_t slot = h & mask; t.slots[slot]; slot = (slot + 1) & mask) {
+                size_t idx = t.slots[slot] - 1;
+                if (t.hashes[idx] == h)
+                    emit(idx);
+            }
+        }
+        return found;
+    }
+};
+
+symbol_index::symbol_index(const elf &f)
+    : m(make_shared<impl>())
+{
+    m->cls = f.get_hdr().ei_class;
+    m->ord = f.get_hdr().ei_data == elfdata::lsb ? byte_order::lsb : byte_order::msb;
+    m->stride = m->cls == elfclass::_32 ? sizeof(Sym<Elf32>) : sizeof(Sym<Elf64>);
+
+    auto &secs = f.sections();
+    int dynsym_index = -1;
+    for (size_t i = 0; i < secs.size(); i++) {
+        sht type = secs[i].get_hdr().type;
+        if (type == sht::dynsym) {
+            m->load(&m->dynsym, secs[i], f);
+            dynsym_index = i;
+        } else if (type == sht::symtab) {
+            m->load(&m->symtab, secs[i], f);
+        }
+    }
+
+    if (dynsym_index >= 0) {
+        // 优先使用 .gnu.hash，其次是 .hash
+        for (auto &sec : secs)
+            if (sec.get_hdr().type == sht::gnu_hash &&
+                sec.get_hdr().link == (unsigned)dynsym_index &&
+                m->load_gnu_hash(&m->dynsym, sec))
+                break;
+        if (m->dynsym.kind == impl::table::hash_kind::none)
+            for (auto &sec : secs)
+                if (sec.get_hdr().type == sht::hash &&
+                    sec.get_hdr().link == (unsigned)dynsym_index &&
+                    m->load_sysv_hash(&m->dynsym, sec))
+                    break;
+        if (m->dynsym.kind == impl::table::hash_kind::none)
+            m->build_open(&m->dynsym, m->dynsym.count);
+        else if (m->dynsym.kind == impl::table::hash_kind::gnu)
+            m->build_open(&m->dynsym, m->dynsym.symoffset);
+    }
+    if (m->symtab.count)
+        m->build_open(&m->symtab, m->symtab.count);
+}
+
+size_t
+symbol_index::find(const char *name, size_t len, symbol_ref *out, size_t max) const
+{
+    if (!m)
+        return 0;
+    size_t found = m->lookup(m->dynsym, name, len, out, max);
+    found += m->lookup(m->symtab, name, len,
+                       found < max ? out + found : nullptr,
+                       found < max ? max - found : 0);
+    return found;
+}
+
+size_t
+symbol_index::size() const
+{
+    return m ? m->dynsym.count + m->symtab.count : 0;
+}
+
+} // namespace elf
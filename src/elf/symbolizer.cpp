@@ -0,0 +1,73 @@
+#include "elf/elf.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace elf
+{
+
+struct symbolizer::impl {
+    // 按 (地址, 大小) 排序，同一地址的别名中最大的排在最后
+    vector<symbol_ref> syms;
+};
+
+symbolizer::symbolizer(const elf &f)
+    : m(make_shared<impl>())
+{
+    // 优先使用完整的 .symtab，只有被strip时才退回到 .dynsym
+    const section *table = nullptr;
+    for (auto &sec : f.sections()) {
+        if (sec.get_hdr().type == sht::symtab) {
+            table = &sec;
+            break;
+        }
+        if (sec.get_hdr().type == sht::dynsym && !table)
+            table = &sec;
+    }
+    if (!table || !table->data())
+        return;
+
+    symtab tab = table->as_symtab();
+    m->syms.reserve(table->size() / (f.get_hdr().ei_class == elfclass::_32 ? sizeof(Sym<Elf32>) : sizeof(Sym<Elf64>)));
+    for (auto sym : tab) {
+        const Sym<> &d = sym.get_data();
+        if ((d.type() != stt::func && d.type() != stt::object) ||
+            d.shnxd == shn::undef || d.size == 0)
+            continue;
+        size_t len;
+        const char *name = sym.get_name(&len);
+        m->syms.push_back(symbol_ref{name, len, d, table->get_hdr().type});
+    }
+
+    auto &syms = m->syms;
+    sort(syms.begin(), syms.end(), [](const symbol_ref &a, const symbol_ref &b) {
+        if (a.data.value != b.data.value)
+            return a.data.value < b.data.value;
+        return a.data.size < b.data.size;
+    });
+    syms.shrink_to_fit();
+}
+
+bool symbolizer::symbolize(Elf64::Addr addr, symbol_ref *out, Elf64::Off *offset) const
+{
+    if (!m)
+        return false;
+    auto &syms = m->syms;
+    auto it = upper_bound(syms.begin(), syms.end(), addr,
+                          [](Elf64::Addr addr, const symbol_ref &s) { return addr < s.data.value; });
+    if (it == syms.begin())
+        return false;
+    --it;
+    if (addr - it->data.value >= it->data.size)
+        return false;
+    *out = *it;
+    *offset = addr - it->data.value;
+    return true;
+}
+
+size_t symbolizer::size() const
+{
+    return m ? m->syms.size() : 0;
+}
+
+} // namespace elf
@@ -100,6 +100,8 @@ to_string(sht v)
         return "dynsym";
     case sht::loos:
         break;
+    case sht::gnu_hash:
+        return "gnu_hash";
     case sht::hios:
         break;
     case sht::loproc:
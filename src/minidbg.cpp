@@ -7,6 +7,10 @@
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <regex>
+#include <cstring>
+#include <set>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -22,55 +26,27 @@ using namespace minidbg;
 
 class ptrace_expr_context : public dwarf::expr_context {
 public:
-    ptrace_expr_context (pid_t pid, uint64_t load_address) : 
-       m_pid{pid}, m_load_address(load_address) {}
+    ptrace_expr_context (register_cache& regs, process_memory& memory, uint64_t load_address) : 
+       m_regs{regs}, m_memory{memory}, m_load_address(load_address) {}
 
     dwarf::taddr reg (unsigned regnum) override {
-        return get_register_value_from_dwarf_register(m_pid, regnum);
+        return m_regs.get_from_dwarf_register(regnum);
     }
 
     dwarf::taddr pc() override {
-        return get_register_value(m_pid, PROGRAM_COUNT) - m_load_address;
+        return m_regs.get(PROGRAM_COUNT) - m_load_address;
     }
 
     dwarf::taddr deref_size (dwarf::taddr address, unsigned size) override {
-        //TODO take into account size
-        return ptrace(PTRACE_PEEKDATA, m_pid, address + m_load_address, nullptr);
+        return m_memory.read_value(address + m_load_address, size);
     }
 
 private:
-    pid_t m_pid;
+    register_cache& m_regs;
+    process_memory& m_memory;
     uint64_t m_load_address;
 };
 
-bool find_pc(const dwarf::die &d, dwarf::taddr pc, std::vector<dwarf::die> *stack)
-{
-    using namespace dwarf;
-
-    // Scan children first to find most specific DIE
-    bool found = false;
-    for (auto &child : d) {
-        if ((found = find_pc(child, pc, stack)))
-            break;
-    }
-    switch (d.tag) {
-    case DW_TAG::subprogram:
-    case DW_TAG::inlined_subroutine:
-        try {
-            if (found || die_pc_range(d).contains(pc)) {
-                found = true;
-                stack->push_back(d);
-            }
-        } catch (std::exception &e) {
-
-        } 
-        break;
-    default:
-        break;
-    }
-    return found;
-}
-
 /**
  * @brief 获取对应的比特位
  * 
@@ -117,13 +93,16 @@ void debugger::read_variables() {
     std::vector<Variable> larg; // 函数局部变量
 
 
-    for (const auto& die : func) {
-        if (die.tag == DW_TAG::variable || die.tag == DW_TAG::formal_parameter) {
+    // 在扁平DIE树中按兄弟链遍历函数的子节点，只读取变量和参数的属性
+    auto &tree = func.get_unit().get_die_tree();
+    for (auto ref = tree.find(func.get_unit_offset()).first_child(); ref.valid(); ref = ref.next_sibling()) {
+        if (ref.tag() == DW_TAG::variable || ref.tag() == DW_TAG::formal_parameter) {
+            auto die = ref.get();
             auto loc_val = die[DW_AT::location];
 
             //only supports exprlocs for now
             if (loc_val.get_type() == value::type::exprloc) {
-                ptrace_expr_context context {m_pid, m_load_address};
+                ptrace_expr_context context {m_regs, m_memory, m_load_address};
                 auto result = loc_val.as_exprloc().evaluate(&context);
 
                 switch (result.location_type) {
@@ -138,7 +117,7 @@ void debugger::read_variables() {
 
                 case expr_result::type::reg:
                 {
-                    auto value = get_register_value_from_dwarf_register(m_pid, result.value);
+                    auto value = m_regs.get_from_dwarf_register(result.value);
                     std::cout << at_name(die) << " (reg " << result.value << ") = " << value << std::endl;
                     break;
                 }
@@ -154,7 +133,7 @@ void debugger::read_variables() {
     }
 #if defined(__aarch64__) || defined(__arm64__)
 
-    uint64_t res = read_memory(get_register_value(m_pid, FRAME_POINTER)-farg.size()*4-8);
+    uint64_t res = read_memory(m_regs.get(FRAME_POINTER)-farg.size()*4-8);
     uint32_t code = res&(0xffffffff);
     int offset = get_offset(code);
     for(auto &v:farg) {
@@ -178,23 +157,51 @@ void debugger::read_variables() {
 }
 
 
+std::string debugger::symbolize(uint64_t pc, std::string* name) {
+    elf::symbol_ref sym;
+    elf::Elf64::Off offset;
+    if (!m_elf.get_symbolizer().symbolize(pc, &sym, &offset)) {
+        if (name) {
+            *name = "??";
+        }
+        return "??";
+    }
+    if (name) {
+        name->assign(sym.name, sym.name_len);
+    }
+    std::stringstream ss;
+    ss << std::string(sym.name, sym.name_len) << "+0x" << std::hex << offset;
+    return ss.str();
+}
+
 void debugger::print_backtrace() {
-    auto output_frame = [frame_number = 0] (auto&& func) mutable {
-        std::cout << "frame #" << frame_number++ << ": 0x" << dwarf::at_low_pc(func)
-                  << ' ' << dwarf::at_name(func) << std::endl;
+    int frame_number = 0;
+    // 优先使用调试信息，没有调试信息的函数使用符号表，返回函数名
+    auto output_frame = [&] (uint64_t pc) {
+        std::string name;
+        std::cout << "frame #" << std::dec << frame_number++ << ": 0x" << std::hex;
+        try {
+            auto func = get_function_from_pc(pc);
+            name = dwarf::at_name(func);
+            std::cout << dwarf::at_low_pc(func) << ' ' << name << std::endl;
+        } catch (std::out_of_range&) {
+            // 比较时使用不带偏移量的符号名
+            auto location = symbolize(pc, &name);
+            std::cout << pc << ' ' << location << std::endl;
+        }
+        return name;
     };
 
-    auto current_func = get_function_from_pc(offset_load_address(get_pc()));
-    output_frame(current_func);
+    auto name = output_frame(offset_load_address(get_pc()));
 
-    auto frame_pointer = get_register_value(m_pid, FRAME_POINTER);
-    auto return_address = read_memory(frame_pointer+8);
+    // 栈帧开头依次保存着上一个栈帧的帧指针和返回地址，一次读取
+    uint64_t frame[2];
+    m_memory.read(m_regs.get(FRAME_POINTER), frame, sizeof(frame));
 
-    while (dwarf::at_name(current_func) != "main") {
-        current_func = get_function_from_pc(offset_load_address(return_address));
-        output_frame(current_func);
-        frame_pointer = read_memory(frame_pointer);
-        return_address = read_memory(frame_pointer+8);
+    // 符号表也找不到时无法继续回溯
+    while (name != "main" && name != "??") {
+        name = output_frame(offset_load_address(frame[1]));
+        m_memory.read(frame[0], frame, sizeof(frame));
     }
 }
 
@@ -212,18 +219,31 @@ symbol_type to_symbol_type(elf::stt sym) {
 std::vector<symbol> debugger::lookup_symbol(const std::string& name) {
    std::vector<symbol> syms;
 
-   for (auto& sec : m_elf.sections()) {
-      if (sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym)
-         continue;
-
-      for (auto sym : sec.as_symtab()) {
-         if (sym.get_name() == name) {
-            auto& d = sym.get_data();
-            syms.push_back(symbol{ to_symbol_type(d.type()), sym.get_name(), d.value });
-         }
+   // 调试信息的名字索引中的函数定义，以及符号表中的所有同名符号（对象、PLT 等），
+   // 名字相同，按地址去重
+   std::set<std::uintptr_t> seen;
+   for (auto& die : m_dwarf.get_name_index().find(name)) {
+      if (die.tag == dwarf::DW_TAG::subprogram && die.has(dwarf::DW_AT::low_pc)) {
+         auto addr = at_low_pc(die);
+         if (seen.insert(addr).second)
+            syms.push_back(symbol{ symbol_type::func, name, addr });
       }
    }
 
+   auto& index = m_elf.get_symbol_index();
+   elf::symbol_ref refs[8];
+   auto n = index.find(name.c_str(), name.size(), refs, 8);
+   std::vector<elf::symbol_ref> more;
+   if (n > 8) {
+      more.resize(n);
+      index.find(name.c_str(), name.size(), more.data(), n);
+   }
+   for (size_t i = 0; i < n; ++i) {
+      auto& ref = n > 8 ? more[i] : refs[i];
+      if (seen.insert(ref.data.value).second)
+         syms.push_back(symbol{ to_symbol_type(ref.data.type()), name, ref.data.value });
+   }
+
    return syms;
 }
 
@@ -241,6 +261,51 @@ void debugger::initialise_load_address() {
    }
 }
 
+void debugger::initialise_memory_image() {
+   for (const auto& seg : m_elf.segments()) {
+      auto& hdr = seg.get_hdr();
+      // 可写的段（.data、.bss 以及重定位后只读的 RELRO）在运行时会与文件不同
+      if (hdr.type != elf::pt::load || (hdr.flags & elf::pf::w) != elf::pf(0)) {
+         continue;
+      }
+      m_memory.map_image(offset_dwarf_address(hdr.vaddr), seg.data(), seg.file_size());
+   }
+}
+
+void debugger::initialise_index_cache() {
+    // 只有用户指定了缓存目录时才使用缓存，否则各个索引在第一次查询时构建
+    auto cache_dir = getenv("MINIDBG_INDEX_CACHE");
+    if (!cache_dir || !*cache_dir) {
+        return;
+    }
+    auto build_id = m_elf.get_build_id();
+    if (build_id.empty()) {
+        return;
+    }
+    std::string dir = cache_dir;
+    mkdir(dir.c_str(), 0755);
+
+    // 构建ID相同但文件被修改过（如重新链接时构建ID未变）时缓存失效
+    struct stat st;
+    if (stat(m_prog_name.c_str(), &st) < 0) {
+        return;
+    }
+    std::string key = build_id + ':' + std::to_string(st.st_mtim.tv_sec) + '.' +
+                      std::to_string(st.st_mtim.tv_nsec) + ':' + std::to_string(st.st_size);
+    std::string path = dir + '/' + build_id + ".idx";
+
+    try {
+        if (!m_dwarf.load_index_cache(path, key)) {
+            // 缓存不存在时在所有CPU上并行构建索引
+            m_dwarf.preload();
+            m_dwarf.save_index_cache(path, key);
+        }
+    } catch (std::exception& e) {
+        // 已经构建完成的索引仍然有效，其余的索引在第一次查询时构建
+        std::cerr << "Cannot use index cache " << path << ": " << e.what() << std::endl;
+    }
+}
+
 uint64_t debugger::offset_load_address(uint64_t addr) {
    return addr - m_load_address;
 }
@@ -257,7 +322,7 @@ void debugger::remove_breakpoint(std::intptr_t addr) {
 }
 
 void debugger::step_out() {
-    auto frame_pointer = get_register_value(m_pid, FRAME_POINTER);
+    auto frame_pointer = m_regs.get(FRAME_POINTER);
     auto return_address = read_memory(frame_pointer+8);
 
     bool should_remove_breakpoint = false;
@@ -303,7 +368,7 @@ void debugger::step_over() {
         ++line;
     }
 
-    auto frame_pointer = get_register_value(m_pid, FRAME_POINTER);
+    auto frame_pointer = m_regs.get(FRAME_POINTER);
     auto return_address = read_memory(frame_pointer+8);
     if (!m_breakpoints.count(return_address)) {
         set_breakpoint_at_address(return_address);
@@ -318,6 +383,8 @@ void debugger::step_over() {
 }
 
 void debugger::single_step_instruction() {
+    m_regs.invalidate();
+    m_memory.invalidate();
     ptrace(PTRACE_SINGLESTEP, m_pid, nullptr, nullptr);
     wait_for_signal();
 }
@@ -333,15 +400,15 @@ void debugger::single_step_instruction_with_breakpoint_check() {
 }
 
 uint64_t debugger::read_memory(uint64_t address) {
-    return ptrace(PTRACE_PEEKDATA, m_pid, address, nullptr);
+    return m_memory.read_value(address);
 }
 
 void debugger::write_memory(uint64_t address, uint64_t value) {
-    ptrace(PTRACE_POKEDATA, m_pid, address, value);
+    m_memory.write_value(address, value);
 }
 
 uint64_t debugger::get_pc() {
-    return get_register_value(m_pid, PROGRAM_COUNT);
+    return m_regs.get(PROGRAM_COUNT);
 }
 
 uint64_t debugger::get_offset_pc() {
@@ -349,39 +416,30 @@ uint64_t debugger::get_offset_pc() {
 }
 
 void debugger::set_pc(uint64_t pc) {
-    set_register_value(m_pid, PROGRAM_COUNT, pc);
+    m_regs.set(PROGRAM_COUNT, pc);
 }
 
 dwarf::die debugger::get_function_from_pc(uint64_t pc) {
-    for (auto &cu : m_dwarf.compilation_units()) {
-        if (die_pc_range(cu.root()).contains(pc)) {
-            std::vector<dwarf::die> stack;
-            if (find_pc(cu.root(), pc, &stack)) {
-                for (auto &d : stack) {
-                    return d;
-                }
-            }
-        }
+    auto func = m_dwarf.get_pc_index().find(pc);
+    if (!func.valid()) {
+        throw std::out_of_range{"Cannot find function"};
     }
-
-    throw std::out_of_range{"Cannot find function"};
+    return func;
 }
 
 dwarf::line_table::iterator debugger::get_line_entry_from_pc(uint64_t pc) {
-    for (auto &cu : m_dwarf.compilation_units()) {
-        if (die_pc_range(cu.root()).contains(pc)) {
-            auto &lt = cu.get_line_table();
-            auto it = lt.find_address(pc);
-            if (it == lt.end()) {
-                throw std::out_of_range{"Cannot find line entry"};
-            }
-            else {
-                return it;
-            }
-        }
+    auto cu = m_dwarf.get_aranges().find(pc);
+    if (!cu) {
+        throw std::out_of_range{"Cannot find line entry"};
     }
 
-    throw std::out_of_range{"Cannot find line entry"};
+    // 单步执行时会反复查询同一个行号表，解码一次后使用二分查找
+    auto &lt = cu->get_materialized_line_table();
+    auto it = lt.find_address(pc);
+    if (it == lt.end()) {
+        throw std::out_of_range{"Cannot find line entry"};
+    }
+    return it;
 }
 
 void debugger::print_source(const std::string& file_name, unsigned line, unsigned n_lines_context) {
@@ -428,6 +486,8 @@ void debugger::step_over_breakpoint() {
         auto& bp = m_breakpoints[get_pc()];
         if (bp.is_enabled()) {
             bp.disable();
+            m_regs.invalidate();
+            m_memory.invalidate();
             ptrace(PTRACE_SINGLESTEP, m_pid, nullptr, nullptr);
             wait_for_signal();
             bp.enable();
@@ -464,8 +524,13 @@ void debugger::handle_sigtrap(siginfo_t info) {
         set_pc(get_pc() - offset);
         std::cout << "Hit breakpoint at address 0x" << std::hex << get_pc() << std::endl;
         auto offset_pc = offset_load_address(get_pc()); //rember to offset the pc for querying DWARF
-        auto line_entry = get_line_entry_from_pc(offset_pc);
-        print_source(line_entry->file->path, line_entry->line);
+        try {
+            auto line_entry = get_line_entry_from_pc(offset_pc);
+            print_source(line_entry->file->path, line_entry->line);
+        } catch (std::out_of_range&) {
+            // 没有行号信息时只能显示符号
+            std::cout << "in " << symbolize(offset_pc) << std::endl;
+        }
         return;
     }
     //this will be set if the signal was sent by single stepping
@@ -479,14 +544,28 @@ void debugger::handle_sigtrap(siginfo_t info) {
 
 void debugger::continue_execution() {
     step_over_breakpoint();
+    m_regs.invalidate();
+    m_memory.invalidate();
     ptrace(PTRACE_CONT, m_pid, nullptr, nullptr);
     wait_for_signal();
 }
 
+void debugger::dump_memory(uint64_t address, size_t len) {
+    std::vector<uint8_t> buf(len);
+    m_memory.read(address, buf.data(), len);
+    for (size_t off = 0; off < len; off += 16) {
+        std::cout << "0x" << std::setfill('0') << std::setw(16) << std::hex << address + off << ':';
+        for (size_t i = off; i < std::min(off + 16, len); ++i) {
+            std::cout << ' ' << std::setw(2) << static_cast<unsigned>(buf[i]);
+        }
+        std::cout << std::endl;
+    }
+}
+
 void debugger::dump_registers() {
     for (const auto& rd : g_register_descriptors) {
         std::cout << rd.name << " 0x"
-                  << std::setfill('0') << std::setw(16) << std::hex << get_register_value(m_pid, rd.r) << std::endl;
+                  << std::setfill('0') << std::setw(16) << std::hex << m_regs.get(rd.r) << std::endl;
     }
 }
 
@@ -545,24 +624,55 @@ void debugger::handle_command(const std::string& line) {
         if (is_prefix(args[1], "dump")) {
             dump_registers();
         }
-        else if (is_prefix(args[1], "read")) {
-            std::cout << get_register_value(m_pid, get_register_from_name(args[2])) << std::endl;
+        else if (is_prefix(args[1], "read") || is_prefix(args[1], "write")) {
+            reg r;
+            try {
+                r = get_register_from_name(args[2]);
+            } catch (std::out_of_range&) {
+                std::cerr << "Unknown register " << args[2] << std::endl;
+                return;
+            }
+            if (is_prefix(args[1], "read")) {
+                std::cout << std::hex << m_regs.get(r) << std::endl;
+            }
+            else {
+                std::string val {args[3], 2}; //assume 0xVAL
+                m_regs.set(r, std::stoull(val, 0, 16));
+            }
         }
-        else if (is_prefix(args[1], "write")) {
-            std::string val {args[3], 2}; //assume 0xVAL
-            set_register_value(m_pid, get_register_from_name(args[2]), std::stoll(val, 0, 16));
+    }
+
+    // 放在 register 之后，使 r 仍然是 register 的缩写
+    else if(is_prefix(command, "rbreak")) {
+        // 正则表达式中可能有空格，使用命令之后的整行
+        auto pos = line.find(' ');
+        if (pos == std::string::npos) {
+            std::cerr << "Usage: rbreak <regex>\n";
+            return;
         }
+        set_breakpoint_at_regex(line.substr(pos + 1));
     }
 
     else if(is_prefix(command, "memory")) {
+        if (is_prefix(args[1], "stats")) {
+            std::cout << "page cache hits " << std::dec << m_memory.hits()
+                      << " misses " << m_memory.misses()
+                      << " image reads " << m_memory.image_reads() << std::endl;
+            return;
+        }
         std::string addr {args[2], 2}; //assume 0xADDRESS
 
         if (is_prefix(args[1], "read")) {
-            std::cout << std::hex << read_memory(std::stoll(addr, 0, 16)) << std::endl;
+            if (args.size() < 4) {
+                std::cout << std::hex << read_memory(std::stoull(addr, 0, 16)) << std::endl;
+            }
+            else {
+                dump_memory(std::stoull(addr, 0, 16), std::stoull(args[3], 0, 0));
+            }
         }
         if (is_prefix(args[1], "write")) {
             std::string val {args[3], 2}; //assume 0xVAL
-            write_memory(std::stol(addr, 0, 16), std::stoll(val, 0, 16));
+            write_memory(std::stoull(addr, 0, 16), std::stoull(val, 0, 16));
         }
     }
 
@@ -589,43 +699,122 @@ void debugger::handle_command(const std::string& line) {
     }
 }
 
-bool is_suffix(const std::string& s, const std::string& of) {
-    if (s.size() > of.size()) return false;
-    auto diff = of.size() - s.size();
-    return std::equal(s.begin(), s.end(), of.begin() + diff);
-}
-
 void debugger::set_breakpoint_at_function(const std::string& name) {
-    for (const auto& cu : m_dwarf.compilation_units()) {
-        for (const auto& die : cu.root()) {
-            if (die.has(dwarf::DW_AT::name) && at_name(die) == name) {
-                auto low_pc = at_low_pc(die);
-                auto entry = get_line_entry_from_pc(low_pc);
-                ++entry; //skip prologue
-                set_breakpoint_at_address(offset_dwarf_address(entry->address));
-            }
+    // name 可以是完整的限定名或其后缀，如 ns::Foo::bar、Foo::bar 或 bar
+    std::vector<std::intptr_t> addrs;
+    for (const auto& die : m_dwarf.get_function_index().find_suffix(name)) {
+        // 只由 DW_AT_ranges 描述的函数没有唯一的入口地址
+        if (!die.has(dwarf::DW_AT::low_pc))
+            continue;
+        try {
+            auto entry = get_line_entry_from_pc(at_low_pc(die));
+            ++entry; //skip prologue
+            addrs.push_back(offset_dwarf_address(entry->address));
+        } catch (std::out_of_range&) {
+            // 没有行号信息的副本（如被丢弃的 COMDAT 函数）不设置断点
         }
     }
+    if (addrs.empty()) {
+        std::cerr << "Cannot find function " << name << std::endl;
+        return;
+    }
+
+    // 同一函数的多个副本可能解析到同一地址，排序去重后只设置一次
+    std::sort(addrs.begin(), addrs.end());
+    addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+    set_breakpoints_at_addresses(addrs);
+    for (auto addr : addrs) {
+        std::cout << "Set breakpoint at address 0x" << std::hex << addr << std::endl;
+    }
 }
 
 void debugger::set_breakpoint_at_source_line(const std::string& file, unsigned line) {
-    for (const auto& cu : m_dwarf.compilation_units()) {
-        if (is_suffix(file, at_name(cu.root()))) {
-            const auto& lt = cu.get_line_table();
-
-            for (const auto& entry : lt) {
-                if (entry.is_stmt && entry.line == line) {
-                    set_breakpoint_at_address(offset_dwarf_address(entry.address));
-                    return;
-                }
-            }
+    // 同一行可能被内联到多处或出现在多个编译单元中，每个位置都设置断点
+    auto addrs = m_dwarf.get_line_index().find(file, line);
+    if (addrs.empty()) {
+        std::cerr << "Cannot find " << file << ':' << std::dec << line << std::endl;
+        return;
+    }
+    for (auto addr : addrs) {
+        set_breakpoint_at_address(offset_dwarf_address(addr));
+    }
+}
+
+void debugger::set_breakpoint_at_regex(const std::string& regex) {
+    std::regex re;
+    try {
+        re = std::regex{regex};
+    } catch (std::regex_error& e) {
+        std::cerr << "Invalid regex " << regex << ": " << e.what() << std::endl;
+        return;
+    }
+
+    // 限定名只匹配一次，同名的重载共用匹配结果
+    auto& index = m_dwarf.get_function_index();
+    std::vector<dwarf::taddr> entries;
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (!std::regex_search(index.get_name(i), re))
+            continue;
+        for (const auto& die : index.get_functions(i)) {
+            if (die.has(dwarf::DW_AT::low_pc))
+                entries.push_back(at_low_pc(die));
+        }
+    }
+
+    // 按地址排序后，同一编译单元的函数相邻，连续查询同一个行号表
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+    std::vector<std::intptr_t> addrs;
+    addrs.reserve(entries.size());
+    for (auto low_pc : entries) {
+        try {
+            auto entry = get_line_entry_from_pc(low_pc);
+            ++entry; //skip prologue
+            addrs.push_back(offset_dwarf_address(entry->address));
+        } catch (std::out_of_range&) {
+            // 没有行号信息的函数无法跳过序言，不设置断点
         }
     }
+
+    auto n = set_breakpoints_at_addresses(std::move(addrs));
+    std::cout << "Set " << std::dec << n << " breakpoints on " << entries.size()
+              << " functions matching " << regex << std::endl;
+}
+
+size_t debugger::set_breakpoints_at_addresses(std::vector<std::intptr_t> addrs) {
+    std::sort(addrs.begin(), addrs.end());
+    addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+    addrs.erase(std::remove_if(addrs.begin(), addrs.end(),
+                               [&](std::intptr_t addr) { return m_breakpoints.count(addr); }),
+                addrs.end());
+
+    const std::intptr_t page_size = sysconf(_SC_PAGESIZE);
+    std::vector<uint8_t> buf;
+    for (size_t i = 0; i < addrs.size();) {
+        // 起始地址在同一页中的断点一起读写，范围延伸到最后一个断点的指令末尾
+        auto start = addrs[i];
+        auto page_end = (start & ~(page_size - 1)) + page_size;
+        auto j = i;
+        while (j < addrs.size() && addrs[j] < page_end)
+            ++j;
+        buf.resize(addrs[j - 1] + breakpoint::instruction_size - start);
+        m_memory.read(start, buf.data(), buf.size());
+
+        for (auto k = i; k < j; ++k) {
+            breakpoint bp {&m_memory, addrs[k]};
+            bp.enable(buf.data() + (addrs[k] - start));
+            m_breakpoints[addrs[k]] = bp;
+        }
+
+        m_memory.write(start, buf.data(), buf.size());
+        i = j;
+    }
+    return addrs.size();
 }
 
 void debugger::set_breakpoint_at_address(std::intptr_t addr) {
     std::cout << "Set breakpoint at address 0x" << std::hex << addr << std::endl;
-    breakpoint bp {m_pid, addr};
+    breakpoint bp {&m_memory, addr};
     bp.enable();
     m_breakpoints[addr] = bp;
 }
@@ -633,10 +822,16 @@ void debugger::set_breakpoint_at_address(std::intptr_t addr) {
 void debugger::run() {
     wait_for_signal();
     initialise_load_address();
+    initialise_memory_image();
 
     char* line = nullptr;
     while((line = linenoise("minidbg> ")) != nullptr) {
-        handle_command(line);
+        try {
+            handle_command(line);
+        } catch (std::runtime_error& e) {
+            // 如访问了无法读写的内存，报告错误后继续接受命令
+            std::cerr << e.what() << std::endl;
+        }
         linenoiseHistoryAdd(line);
         linenoiseFree(line);
     }
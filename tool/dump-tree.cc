@@ -7,17 +7,20 @@
 
 using namespace std;
 
-void dump_tree(const dwarf::die &node, int depth = 0)
+void dump_tree(const dwarf::unit &cu)
 {
-    printf("%*.s<%" PRIx64 "> %s\n", depth, "",
-           node.get_section_offset(),
-           to_string(node.tag).c_str());
-    for (auto &attr : node.attributes())
-        printf("%*.s      %s %s\n", depth, "",
-               to_string(attr.first).c_str(),
-               to_string(attr.second).c_str());
-    for (auto &child : node)
-        dump_tree(child, depth + 1);
+    // 按先序线性扫描单元的扁平DIE树，深度即缩进
+    for (auto ref : cu.get_die_tree()) {
+        int depth = ref.depth();
+        dwarf::die node = ref.get();
+        printf("%*.s<%" PRIx64 "> %s\n", depth, "",
+               node.get_section_offset(),
+               to_string(node.tag).c_str());
+        for (auto &attr : node.attributes())
+            printf("%*.s      %s %s\n", depth, "",
+                   to_string(attr.first).c_str(),
+                   to_string(attr.second).c_str());
+    }
 }
 
 int main(int argc, char **argv)
@@ -36,9 +39,9 @@ int main(int argc, char **argv)
     elf::elf ef(elf::create_mmap_loader(fd));
     dwarf::dwarf dw(dwarf::elf::create_loader(ef));
 
-    for (auto cu : dw.compilation_units()) {
+    for (auto &cu : dw.compilation_units()) {
         printf("--- <%" PRIx64 ">\n", cu.get_section_offset());
-        dump_tree(cu.root());
+        dump_tree(cu);
     }
 
     return 0;
@@ -13,34 +13,6 @@ void usage(const char *cmd)
     exit(2);
 }
 
-bool find_pc(const dwarf::die &d, dwarf::taddr pc, vector<dwarf::die> *stack)
-{
-    using namespace dwarf;
-
-    // Scan children first to find most specific DIE
-    bool found = false;
-    for (auto &child : d) {
-        if ((found = find_pc(child, pc, stack)))
-            break;
-    }
-    switch (d.tag) {
-    case DW_TAG::subprogram:
-    case DW_TAG::inlined_subroutine:
-        try {
-            if (found || die_pc_range(d).contains(pc)) {
-                found = true;
-                stack->push_back(d);
-            }
-        } catch (out_of_range &e) {
-        } catch (value_type_mismatch &e) {
-        }
-        break;
-    default:
-        break;
-    }
-    return found;
-}
-
 void dump_die(const dwarf::die &node)
 {
     printf("<%" PRIx64 "> %s\n",
@@ -76,33 +48,26 @@ int main(int argc, char **argv)
     dwarf::dwarf dw(dwarf::elf::create_loader(ef));
 
     // Find the CU containing pc
-    // XXX Use .debug_aranges
-    for (auto &cu : dw.compilation_units()) {
-        if (die_pc_range(cu.root()).contains(pc)) {
-            // Map PC to a line
-            auto &lt = cu.get_line_table();
-            auto it = lt.find_address(pc);
-            if (it == lt.end())
-                printf("UNKNOWN\n");
-            else
-                printf("%s\n",
-                       it->get_description().c_str());
+    auto cu = dw.get_aranges().find(pc);
+    if (cu) {
+        // Map PC to a line
+        auto &lt = cu->get_line_table();
+        auto it = lt.find_address(pc);
+        if (it == lt.end())
+            printf("UNKNOWN\n");
+        else
+            printf("%s\n",
+                   it->get_description().c_str());
+    }
 
-            // Map PC to an object
-            // XXX Index/helper/something for looking up PCs
-            // XXX DW_AT_specification and DW_AT_abstract_origin
-            vector<dwarf::die> stack;
-            if (find_pc(cu.root(), pc, &stack)) {
-                bool first = true;
-                for (auto &d : stack) {
-                    if (!first)
-                        printf("\nInlined in:\n");
-                    first = false;
-                    dump_die(d);
-                }
-            }
-            break;
-        }
+    // Map PC to an object
+    // XXX DW_AT_specification and DW_AT_abstract_origin
+    bool first = true;
+    for (auto &d : dw.get_pc_index().find_stack(pc)) {
+        if (!first)
+            printf("\nInlined in:\n");
+        first = false;
+        dump_die(d);
     }
 
     return 0;
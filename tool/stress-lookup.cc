@@ -0,0 +1,135 @@
+#include "dwarf/dwarf.hpp"
+#include "elf/elf.hpp"
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// 一个地址的查询结果，用串行构建的对象计算期望值
+struct pc_result {
+    dwarf::taddr pc;
+    dwarf::section_offset func, cu;
+    string line;
+    string sym;
+};
+
+void usage(const char *cmd)
+{
+    fprintf(stderr, "usage: %s elf-file [threads [rounds]]\n", cmd);
+    exit(2);
+}
+
+elf::elf load(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    return elf::elf(elf::create_mmap_loader(fd));
+}
+
+pc_result lookup(const elf::elf &ef, const dwarf::dwarf &dw, dwarf::taddr pc)
+{
+    pc_result r{pc, ~(dwarf::section_offset)0, ~(dwarf::section_offset)0, "", ""};
+    auto func = dw.get_pc_index().find(pc);
+    // 索引找到的函数必须包含 pc，同时在多个线程上使用范围表缓存
+    if (func.valid() && die_pc_contains(func, pc))
+        r.func = func.get_section_offset();
+    auto cu = dw.get_aranges().find(pc);
+    if (cu) {
+        r.cu = cu->get_section_offset();
+        auto &lt = cu->get_materialized_line_table();
+        auto it = lt.find_address(pc);
+        if (it != lt.end())
+            r.line = it->get_description();
+    }
+    elf::symbol_ref sym;
+    elf::Elf64::Off off;
+    if (ef.get_symbolizer().symbolize(pc, &sym, &off))
+        r.sym = string(sym.name, sym.name_len);
+    return r;
+}
+
+bool same(const pc_result &a, const pc_result &b)
+{
+    return a.func == b.func && a.cu == b.cu && a.line == b.line && a.sym == b.sym;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 4)
+        usage(argv[0]);
+    unsigned threads = argc > 2 ? stoul(argv[2]) : thread::hardware_concurrency();
+    unsigned rounds = argc > 3 ? stoul(argv[3]) : 10;
+    if (threads == 0)
+        threads = 4;
+
+    // 串行地计算每个行号表地址和每个函数名的期望结果
+    elf::elf ref_elf = load(argv[1]);
+    dwarf::dwarf ref(dwarf::elf::create_loader(ref_elf));
+    vector<pc_result> pcs;
+    vector<pair<string, size_t>> names;
+    for (auto &cu : ref.compilation_units()) {
+        for (auto &line : cu.get_line_table())
+            if (!line.end_sequence)
+                pcs.push_back(lookup(ref_elf, ref, line.address));
+    }
+    for (auto &r : pcs) {
+        auto func = ref.get_pc_index().find(r.pc);
+        if (func.valid() && func.has(dwarf::DW_AT::name)) {
+            string name = at_name(func);
+            names.emplace_back(name, ref.get_name_index().find(name).size());
+        }
+    }
+    if (pcs.empty()) {
+        fprintf(stderr, "%s: no line table entries\n", argv[1]);
+        return 1;
+    }
+
+    atomic<size_t> lookups(0), mismatches(0);
+    for (unsigned round = 0; round < rounds; round++) {
+        // 每一轮使用新的对象，使所有线程同时触发惰性初始化
+        elf::elf ef = load(argv[1]);
+        dwarf::dwarf dw(dwarf::elf::create_loader(ef));
+        atomic<unsigned> ready(0);
+        vector<thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                ready++;
+                while (ready < threads)
+                    this_thread::yield();
+                // 各线程从不同的位置开始，使不同的编译单元被同时初始化
+                size_t start = pcs.size() * t / threads;
+                for (size_t i = 0; i < pcs.size(); i++) {
+                    const pc_result &want = pcs[(start + i) % pcs.size()];
+                    if (!same(lookup(ef, dw, want.pc), want)) {
+                        if (mismatches++ < 10)
+                            fprintf(stderr, "mismatch at %#" PRIx64 "\n", want.pc);
+                    }
+                    lookups++;
+                }
+                for (size_t i = 0; i < names.size(); i++) {
+                    auto &want = names[(start + i) % names.size()];
+                    if (dw.get_name_index().find(want.first).size() != want.second) {
+                        if (mismatches++ < 10)
+                            fprintf(stderr, "mismatch for %s\n", want.first.c_str());
+                    }
+                    lookups++;
+                }
+            });
+        }
+        for (auto &w : workers)
+            w.join();
+    }
+
+    printf("%u threads, %u rounds, %zu lookups, %zu mismatches\n",
+           threads, rounds, lookups.load(), mismatches.load());
+    return mismatches ? 1 : 0;
+}